@@ -88,6 +88,15 @@ struct emu_temp_var
     int     top;
 };
 
+/* 预解码出来的一条指令，按 offset 升序排列 */
+struct arm_predecode_inst {
+    /* 相对于 predecode.base 的字节偏移 */
+    int                 offset;
+    int                 len;
+    /* 查表失败或者长度和top-5-bit规则对不上时为NULL，顺序解码时回退到 arm_insteng_parse */
+    struct reg_node     *node;
+};
+
 struct arm_emu {
     struct {
         unsigned char *data;
@@ -161,6 +170,8 @@ struct arm_emu {
         unsigned dfa :1;
         unsigned mblk : 1;
         unsigned cfg : 1;
+        /* 执行指令时生成反汇编文本，只有打印指令的时候才打开 */
+        unsigned inst : 1;
     } dump;
 
     /* target machine内的函数起始位置 */
@@ -182,6 +193,16 @@ struct arm_emu {
 
     struct minst_blk        mblk;
     struct minst            *prev_minst;
+
+    /* 大块代码先多线程线性扫描一遍，first pass 顺序执行时直接拿结果 */
+    struct {
+        uint8_t                     *base;
+        int                         len;
+        struct arm_predecode_inst   *tab;
+        int                         num;
+        /* first pass 是单调往后走的，游标只需要前进 */
+        int                         cur;
+    } predecode;
 };
 
 static const char *regstr[] = {
@@ -212,13 +233,63 @@ struct arm_inst_desc {
     int index;
 };
 
+enum arm_inst_field {
+    ARM_FIELD_S,
+    ARM_FIELD_T,
+    ARM_FIELD_I,
+    ARM_FIELD_C,
+    ARM_FIELD_D,
+    ARM_FIELD_U,
+    ARM_FIELD_W,
+    ARM_FIELD_P,
+    ARM_FIELD_M,
+    ARM_FIELD_LN,
+    ARM_FIELD_LM,
+    ARM_FIELD_LP,
+    ARM_FIELD_LD,
+    ARM_FIELD_LE,
+    ARM_FIELD_VD,
+    ARM_FIELD_RL,
+};
+
+/* 预编译好的字段提取操作，值为 ((code[half] >> shift) & mask) + bias */
+struct arm_inst_field_op {
+    unsigned char field;
+    unsigned char half;
+    unsigned char shift;
+    unsigned char bias;
+    unsigned int  mask;
+};
+
+#define ARM_INST_FIELD_MAX          16
+
+/* 由指令正则表达式编译出来的字段提取程序，避免每次执行指令时都要重新解析正则 */
+struct arm_inst_prog {
+    int num;
+    struct arm_inst_field_op ops[ARM_INST_FIELD_MAX];
+};
+
 
 #include "arm_op.h"
 
 static struct reg_node*     arm_insteng_parse(uint8_t *code, int len, int *olen);
 static int arm_minst_do(struct arm_emu *emu, struct minst *minst);
+static int arm_inst_prog_compile(struct arm_inst_prog *prog, const char *oexp);
+static void arm_inst_prog_exec(struct arm_inst_ctx *ctx, const struct arm_inst_prog *prog, uint8_t *code, int code_len);
 int         arm_emu_reduce_csm(struct arm_emu *emu);
 
+static struct minst*        arm_minst_new_mov(struct minst_cfg *cfg, enum minst_type type, int rd, int rm);
+static struct minst*        arm_minst_new_movw(struct minst_cfg *cfg, enum minst_type type, int rd, int imm16);
+static struct minst*        arm_minst_new_movt(struct minst_cfg *cfg, enum minst_type type, int rd, int imm16);
+static struct minst*        arm_minst_new_cmp(struct minst_cfg *cfg, enum minst_type type, int rn, int rm);
+static struct minst*        arm_minst_new_b(struct minst_cfg *cfg, enum minst_type type);
+static struct minst*        arm_minst_new_bcond(struct minst_cfg *cfg, enum minst_type type, int cond);
+static struct minst*        arm_minst_change_b(struct minst *minst);
+static int  arm_emu_minst_cond(void *_emu, struct minst *minst);
+static int  arm_emu_minst_pure(struct minst *minst);
+static int  arm_emu_minst_fields(struct minst *minst, unsigned char *code, int *regs);
+static int  arm_emu_minst_rename(struct minst *minst, int *map);
+
 const char* arm_reg2str(int reg)
 {
     static char buf[20];
@@ -295,7 +366,7 @@ static char* reglist2str(int reglist, char *buf)
     return buf;
 }
 
-static void arm_prepare_dump(struct arm_emu *emu, const char *fmt, ...)
+static void arm__prepare_dump(struct arm_emu *emu, const char *fmt, ...)
 {
     va_list ap;
     va_start(ap, fmt);
@@ -303,13 +374,19 @@ static void arm_prepare_dump(struct arm_emu *emu, const char *fmt, ...)
     va_end(ap);
 }
 
-static int arm_dump_bitset(const char *desc, struct bitset *v, char *obuf)
+/* 各种分析pass会反复执行指令，但只有打印的时候才需要反汇编文本，没有打开 dump.inst 时
+参数都不会被求值，所以不要在参数里写有副作用的表达式 */
+#define arm_prepare_dump(emu, ...)      do { \
+        if ((emu)->dump.inst) arm__prepare_dump(emu, __VA_ARGS__); \
+    } while (0)
+
+static int arm_dump_rset(const char *desc, struct rset *v, char *obuf)
 {
     char *o = obuf;
     int olen = 0, pos = -1;
     /* dump liveness calculate result */
     olen = sprintf(o += olen, "[%s: ", desc);
-    while ((pos = bitset_next_bit_pos(v, pos + 1)) >= 0) {
+    while ((pos = rset_next_bit_pos(v, pos + 1)) >= 0) {
         olen = sprintf(o += olen, "%d  ", pos);
     }
     if (o[olen - 1] == ' ') olen--;
@@ -318,24 +395,17 @@ static int arm_dump_bitset(const char *desc, struct bitset *v, char *obuf)
     return (o + olen) - obuf;
 }
 
-static int arm_dump_temp_reglist(const char *desc, struct bitset *v, char *obuf)
+static int arm_dump_temp_reglist(const char *desc, struct live_regs *v, char *obuf)
 {
     char *o = obuf;
-    int i, j, olen = 0;
+    int i, olen = 0;
     /* dump liveness calculate result */
     olen = sprintf(o += olen, "[%s: ", desc);
-    if (v->len4) {
-        for (i = 0; i < 32; i++) {
-            if (v->data[0] & (1 << i))
-                olen = sprintf(o += olen, "%s ", regstr[i]);
-        }
-
-        for (i = 1; i < v->len4; i++) {
-            for (j = 0; j < 32; j++) {
-                if (v->data[i] & (1 << j))
-                    olen = sprintf(o += olen, "t%d ", i * 32 + j);
-            }
-        }
+    live_regs_foreach(v, i) {
+        if (i < 32)
+            olen = sprintf(o += olen, "%s ", regstr[i]);
+        else
+            olen = sprintf(o += olen, "t%d ", i);
     }
     if (o[olen - 1] == ' ') olen--;
     olen = sprintf(o += olen, "] ");
@@ -412,9 +482,9 @@ static int arm_inst_print_format(struct arm_emu *emu, struct minst *minst, unsig
     }
 
     if (flag & IDUMP_REACHING_DEFS) {
-        olen = arm_dump_bitset("r_in", &minst->rd_in, o += olen);
-        olen = arm_dump_bitset("r_out", &minst->rd_out, o+= olen);
-        olen = arm_dump_bitset("kills", &minst->kills, o += olen);
+        olen = arm_dump_rset("r_in", minst_rd_in(minst), o += olen);
+        olen = arm_dump_rset("r_out", minst_rd_out(minst), o+= olen);
+        olen = arm_dump_rset("kills", minst_kills(minst), o += olen);
     }
 
     o += olen;
@@ -584,7 +654,8 @@ static int t1_inst_add(struct arm_emu *emu, struct minst *minst, uint16_t *code,
 {
     int imm32, skip = 0, setflags = 0;
     if ((code[0] & 0xf000) == 0xa000) {
-        arm_prepare_dump(emu, "add %s, sp, #0x%x", regstr[emu->code.ctx.ld], imm32 = emu->code.ctx.imm * 4);
+        imm32 = emu->code.ctx.imm * 4;
+        arm_prepare_dump(emu, "add %s, sp, #0x%x", regstr[emu->code.ctx.ld], imm32);
         live_use_set(&emu->mblk, ARM_REG_SP);
     }
     /* P104.T2 */
@@ -804,8 +875,6 @@ static int t1_inst_and(struct arm_emu *emu, struct minst *minst, uint16_t *code,
 
 static int thumb_inst_const_on_bcond_it(struct arm_emu *emu, struct minst *minst)
 {
-    char bincode[16];
-    int binlen;
     struct minst *cminst, *tminst, *t;
 
     if (!EMU_IS_CONST_MODE(emu)) return 0;
@@ -826,9 +895,8 @@ static int thumb_inst_const_on_bcond_it(struct arm_emu *emu, struct minst *minst
         minst_del_edge(minst, tminst);
 
         /* 删除一条边以后，bcond指令就要改成b指令了 */
-        arm_asm2bin(bincode, &binlen, "b");
         live_use_clear(&emu->mblk, ARM_REG_APSR);
-        t = minst_change(minst, mtype_b, arm_insteng_parse(bincode, binlen, NULL),  bincode, binlen);
+        t = arm_minst_change_b(minst);
         t->succs.f.true_label = 0;
     }
 
@@ -871,7 +939,8 @@ static int thumb_inst_it(struct arm_emu *emu, struct minst *minst, uint16_t *cod
     if ((0xe == firstcond) && (BitCount(mask) != 1)) ARM_UNPREDICT();
     if (minst_in_it_block(minst)) ARM_UNPREDICT();
 
-    arm_prepare_dump(emu, "i%s %s", it2str(firstcond, mask, emu->it.et), condstr[firstcond]);
+    it2str(firstcond, mask, emu->it.et);
+    arm_prepare_dump(emu, "i%s %s", emu->it.et, condstr[firstcond]);
 
     emu->it.cond = firstcond;
     minst->type = mtype_it;
@@ -945,11 +1014,12 @@ static int thumb_inst_orr(struct arm_emu *emu, struct minst *minst, uint16_t *co
     }
     else {
         imm = BITS_GET_SHL(code[1], 12, 3, 2) + BITS_GET_SHL(code[1], 6, 2, 0);
+        s = EC().setflags;
         if (imm)
-            arm_prepare_dump(emu, "orr%s%s.w %s, %s, %s, %d", (s = EC().setflags) ? "s":"", minst_it_cond_str(minst), 
+            arm_prepare_dump(emu, "orr%s%s.w %s, %s, %s, %d", s ? "s":"", minst_it_cond_str(minst), 
                 regstr[EC().ld], regstr[EC().ln], regstr[EC().lm], EC().imm);
         else
-            arm_prepare_dump(emu, "orr%s%s.w %s, %s, %s", (s = EC().setflags) ? "s":"", minst_it_cond_str(minst), 
+            arm_prepare_dump(emu, "orr%s%s.w %s, %s, %s", s ? "s":"", minst_it_cond_str(minst), 
                 regstr[EC().ld], regstr[EC().ln], regstr[EC().lm]);
     }
 
@@ -1023,6 +1093,7 @@ static int thumb_inst_ldrb(struct arm_emu *emu, struct minst *minst, uint16_t *c
 }
 
 static struct arm_inst_desc ldr_iteral_desc =  {"1111 1000 u1 101 1111 ld4 i12", { NULL }, { "ldr.w" }};
+static struct arm_inst_prog ldr_iteral_prog;
 
 static int thumb_inst_ldr(struct arm_emu *emu, struct minst *minst, uint16_t *code, int len)
 {
@@ -1031,7 +1102,8 @@ static int thumb_inst_ldr(struct arm_emu *emu, struct minst *minst, uint16_t *co
 
     if (len == 1) {
         if (sigcode == 0b0100) {
-            arm_prepare_dump(emu, "ldr %s, [pc, #0x%x] ", regstr[emu->code.ctx.ld], imm = emu->code.ctx.imm * 4);
+            imm = emu->code.ctx.imm * 4;
+            arm_prepare_dump(emu, "ldr %s, [pc, #0x%x] ", regstr[emu->code.ctx.ld], imm);
 
             if (!minst->flag.is_const) {
                 addr = ARM_PC_VAL(emu);
@@ -1093,7 +1165,9 @@ static int thumb_inst_ldr(struct arm_emu *emu, struct minst *minst, uint16_t *co
         else if (0) {
         ldr_literal:
             live_use_clear(&emu->mblk, EC().ln);
-            arm_inst_extract_ctx(&emu->code.ctx, ldr_iteral_desc.regexp, minst->addr, minst->len);
+            if (!ldr_iteral_prog.num)
+                arm_inst_prog_compile(&ldr_iteral_prog, ldr_iteral_desc.regexp);
+            arm_inst_prog_exec(&emu->code.ctx, &ldr_iteral_prog, minst->addr, minst->len);
             arm_prepare_dump(emu, "ldr.w %s, [pc, #0x%c%x]", regstr[emu->code.ctx.ld], emu->code.ctx.u ? '+' : '-', emu->code.ctx.imm);
             live_use_set(&emu->mblk, ARM_REG_PC);
             live_def_set(&emu->mblk, EC().ld);
@@ -1178,8 +1252,9 @@ static int thumb_inst_str(struct arm_emu *emu, struct minst *minst, uint16_t *co
                 arm_prepare_dump(emu, "str%s %s, [%s]", minst_it_cond_str(minst), regstr[EC().ln], regstr[EC().lm]);
         }
         else {
+            imm = emu->code.ctx.imm * 4;
             if (emu->code.ctx.imm) 
-                arm_prepare_dump(emu, "str %s, [sp,#0x%x]", regstr[EC().lm], imm = (emu->code.ctx.imm * 4));
+                arm_prepare_dump(emu, "str %s, [sp,#0x%x]", regstr[EC().lm], imm);
             else
                 arm_prepare_dump(emu, "str %s, [sp]", regstr[EC().lm]);
 
@@ -1193,14 +1268,17 @@ static int thumb_inst_str(struct arm_emu *emu, struct minst *minst, uint16_t *co
             if (EC().ln == 15) ARM_UNDEFINED();
             if (EC().lp == 15 || BadReg(EC().lm)) ARM_UNPREDICT();
 
-            arm_prepare_dump(emu, "str%s.w %s, [%s,%s,LSL#%x]", minst_it_cond_str(minst), regstr[lm = EC().lp], regstr[EC().ln], regstr[EC().lm], EC().imm);
+            lm = EC().lp;
+            arm_prepare_dump(emu, "str%s.w %s, [%s,%s,LSL#%x]", minst_it_cond_str(minst), regstr[lm], regstr[EC().ln], regstr[EC().lm], EC().imm);
         }
         else {
             /* FIXME:P421, ln == 15 is undefined */
             if (EC().ln == 15) ARM_UNPREDICT();
             if (EC().lm == 15) ARM_UNPREDICT();
 
-            arm_prepare_dump(emu, "str%s.w %s, [%s,#0x%x]", minst_it_cond_str(minst), regstr[lm = EC().lm], regstr[EC().ln], imm = EC().imm);
+            lm = EC().lm;
+            imm = EC().imm;
+            arm_prepare_dump(emu, "str%s.w %s, [%s,#0x%x]", minst_it_cond_str(minst), regstr[lm], regstr[EC().ln], imm);
 
             reg = EC().ln;
         }
@@ -1281,7 +1359,8 @@ static int t1_inst_mov_w(struct arm_emu *emu, struct minst *minst, uint16_t *ins
 {
     int imm = BITS_GET_SHL(inst[0], 10, 1, 11) + BITS_GET_SHL(inst[1], 12, 3, 8) + BITS_GET_SHL(inst[1], 0, 8, 0), imm1;
 
-    arm_prepare_dump(emu, "mov%s.w %s, #0x%x", minst_it_cond_str(minst), regstr[emu->code.ctx.ld], imm1 = ThumbExpandImmWithC(emu, imm).v);
+    imm1 = ThumbExpandImmWithC(emu, imm).v;
+    arm_prepare_dump(emu, "mov%s.w %s, #0x%x", minst_it_cond_str(minst), regstr[emu->code.ctx.ld], imm1);
 
     if (!minst->flag.in_it_block)
         minst_set_const(minst, imm1);
@@ -1298,7 +1377,8 @@ static int t1_inst_bx_0100(struct arm_emu *emu, struct minst *minst, uint16_t *c
 
 static int t1_inst_b(struct arm_emu *emu, struct minst *minst, uint16_t *code, int len)
 {
-    arm_prepare_dump(emu, "b 0x%x", minst->host_addr = (ARM_PC_VAL(emu) + SignExtend(emu->code.ctx.imm, 11) * 2));
+    minst->host_addr = ARM_PC_VAL(emu) + SignExtend(emu->code.ctx.imm, 11) * 2;
+    arm_prepare_dump(emu, "b 0x%x", minst->host_addr);
 
     if (IS_DISABLE_EMU(emu))
         return 0;
@@ -1774,8 +1854,15 @@ struct reg_node {
 
     arm_inst_func func;
     struct dynarray set;
+    /* DFA节点中 set 的hash */
+    unsigned hash;
     char *exp;
     char *desc;
+    /* 终结态才有，DFA节点和NFA节点共享同一份 */
+    const struct arm_inst_prog *prog;
+    /* 终结态在 desclist 和 funclist 中的下标，生成解码表时使用 */
+    int desc_idx;
+    int func_idx;
 };
 
 struct reg_tree {
@@ -1784,6 +1871,14 @@ struct reg_tree {
     struct reg_node root;
 };
 
+/* 两级查找表的第一级，用指令的第一个半字直接索引 */
+struct arm_inst_lut16 {
+    /* 16bit 指令的终结态，leafs 的下标 + 1，0 表示不是16bit指令 */
+    unsigned short leaf;
+    /* thumb32 第二个半字的查找表行号 + 1, 0表示没有后续 */
+    unsigned short row;
+};
+
 struct arm_inst_engine {
     struct reg_tree    enfa;
     struct reg_tree    dfa;
@@ -1791,8 +1886,28 @@ struct arm_inst_engine {
     int width;
     int height;
     int *trans2d;
+
+    /* 所有的DFA终结态，查找表中保存的是这里的下标 */
+    struct dynarray leafs;
+    struct arm_inst_lut16 *lut16;
+    /* 第二级表，thumb32的第二个半字，按高低字节各查一次。
+    高字节那一行保存的是低字节的行号 + 1，低字节那一行保存的是 leafs 的下标 + 1 */
+    unsigned short (*lut8)[256];
+    int lut8_rows;
+};
+
+/* 生成的解码表中的终结态，处理函数由 desclist[desc_idx].funclist[func_idx] 给出 */
+struct arm_inst_tbl_leaf {
+    short desc_idx;
+    short func_idx;
+    const char *exp;
+    const char *desc;
+    struct arm_inst_prog prog;
 };
 
+/* 1: 每次解码时同时走一遍DFA，和查找表的结果做对比，用来验证查找表 */
+#define ARM_INSTENG_LUT_CHECK       0
+
 struct reg_node *reg_node_new(struct reg_tree *tree, struct reg_node *parent)
 {
     struct reg_node *node = calloc(1, sizeof (node[0]));
@@ -1812,6 +1927,9 @@ void reg_node_copy(struct reg_node *dst, struct reg_node *src)
     dst->func = src->func;
     dst->exp = strdup(src->exp);
     dst->desc = strdup(src->desc);
+    dst->prog = src->prog;
+    dst->desc_idx = src->desc_idx;
+    dst->func_idx = src->func_idx;
 }
 
 int reg_node_height(struct reg_node *node)
@@ -1898,9 +2016,10 @@ struct arm_inst_engine *inst_engine_create()
     return engine;
 }
 
-int arm_insteng_add_exp(struct arm_inst_engine *en, const char *exp, const char *desc, arm_inst_func func)
+int arm_insteng_add_exp(struct arm_inst_engine *en, const char *exp, int desc_idx, int func_idx)
 {
     struct reg_node *root = &en->enfa.root;
+    struct arm_inst_prog *prog;
     int j, len = strlen(exp), rep, height, idx;
     const char *s = exp;
 
@@ -1972,8 +2091,16 @@ loop_label:
     }
 
     root->exp = strdup(exp);
-    root->func = func;
-    root->desc = strdup(desc);
+    root->func = desclist[desc_idx].funclist[func_idx];
+    root->desc = strdup(desclist[desc_idx].desc[func_idx]);
+    root->desc_idx = desc_idx;
+    root->func_idx = func_idx;
+
+    prog = calloc(1, sizeof (prog[0]));
+    if (!prog)
+        vm_error("arm_insteng_add_exp() calloc failure");
+    arm_inst_prog_compile(prog, exp);
+    root->prog = prog;
 
     // FIXME:测试完毕可以关闭掉，验证层数是否正确
     height = reg_node_height(root);
@@ -1986,17 +2113,64 @@ loop_label:
 
 static struct arm_inst_engine *g_eng = NULL;
 
-static struct reg_node *reg_node_find(struct reg_tree *tree, struct dynarray *arr)
+/* 子集构造时，用NFA节点集合的hash来查找已经生成的DFA节点 */
+struct reg_node_htab {
+    int size;
+    int len;
+    struct reg_node **tab;
+};
+
+static int reg_node_id_cmp(const void *a, const void *b)
 {
-    struct reg_node *node;
+    return (*(struct reg_node **)a)->id - (*(struct reg_node **)b)->id;
+}
+
+static unsigned reg_node_set_hash(struct dynarray *set)
+{
+    unsigned h = 2166136261u;
     int i;
-    for (i = 0; i < tree->arr.len; i++) {
-        node = (struct reg_node *)tree->arr.ptab[i];
-        if (0 == dynarray_cmp(arr, &node->set))
-            return node;
+
+    for (i = 0; i < set->len; i++) {
+        h = (h ^ ((struct reg_node *)set->ptab[i])->id) * 16777619u;
     }
 
-    return NULL;
+    return h;
+}
+
+static struct reg_node **reg_node_htab_slot(struct reg_node_htab *htab, struct dynarray *set, unsigned hash)
+{
+    struct reg_node **slot;
+    int i = hash & (htab->size - 1);
+
+    for (; *(slot = &htab->tab[i]); i = (i + 1) & (htab->size - 1)) {
+        if (((*slot)->hash == hash) && !dynarray_cmp(set, &(*slot)->set))
+            break;
+    }
+
+    return slot;
+}
+
+static void reg_node_htab_add(struct reg_node_htab *htab, struct reg_node *node)
+{
+    struct reg_node **old = htab->tab;
+    int i, size = htab->size;
+
+    /* 保持装载率不超过一半 */
+    if ((htab->len + 1) * 2 > htab->size) {
+        htab->size = size ? size * 2 : 256;
+        htab->tab = calloc(htab->size, sizeof (htab->tab[0]));
+        if (!htab->tab)
+            vm_error("reg_node_htab_add() calloc failure");
+
+        for (i = 0; i < size; i++) {
+            if (old[i])
+                *reg_node_htab_slot(htab, &old[i]->set, old[i]->hash) = old[i];
+        }
+        free(old);
+    }
+
+    *reg_node_htab_slot(htab, &node->set, node->hash) = node;
+    htab->len++;
 }
 
 static int arm_insteng_gen_dfa(struct arm_inst_engine *eng)
@@ -2004,20 +2178,20 @@ static int arm_insteng_gen_dfa(struct arm_inst_engine *eng)
     struct reg_node *nfa_root = &eng->enfa.root;
 
     struct reg_node *dfa_root = &eng->dfa.root;
-    struct reg_node *node_stack[512], *droot, *nroot, *dnode1, *nnode;
-    struct dynarray set = {0};
-    int stack_top = -1, i, j, need_split;
-
-#define istack_push(a)            (node_stack[++stack_top] = a)
-#define istack_pop()            node_stack[stack_top--]
-#define istack_is_empty()        (stack_top == -1)
+    struct reg_node *droot, *nroot, *dnode1, *nnode;
+    struct dynarray set = {0}, stack = {0};
+    struct reg_node_htab htab = {0};
+    int i, j, need_split;
+    unsigned hash;
 
     dynarray_add(&dfa_root->set, nfa_root);
-    istack_push(dfa_root);
+    dfa_root->hash = reg_node_set_hash(&dfa_root->set);
+    reg_node_htab_add(&htab, dfa_root);
+    dynarray_add(&stack, dfa_root);
     dynarray_reset(&set);
 
-    while (!istack_is_empty()) {
-        droot = istack_pop();
+    while (!dynarray_is_empty(&stack)) {
+        droot = (struct reg_node *)stack.ptab[--stack.len];
 
         for (i = need_split = 0; i < droot->set.len; i++) {
             nroot = (struct reg_node *)droot->set.ptab[i];
@@ -2039,11 +2213,17 @@ static int arm_insteng_gen_dfa(struct arm_inst_engine *eng)
             }
 
             if (!dynarray_is_empty(&set)) {
-                dnode1 = reg_node_find(&eng->dfa, &set);
+                /* 集合按NFA节点id排序，相同的集合才会有相同的hash */
+                qsort(set.ptab, set.len, sizeof (set.ptab[0]), reg_node_id_cmp);
+                hash = reg_node_set_hash(&set);
+
+                dnode1 = *reg_node_htab_slot(&htab, &set, hash);
                 if (!dnode1) {
                     dnode1 = reg_node_new(&eng->dfa, droot);
                     dynarray_copy(&dnode1->set, &set);
-                    istack_push(dnode1);
+                    dnode1->hash = hash;
+                    reg_node_htab_add(&htab, dnode1);
+                    dynarray_add(&stack, dnode1);
                 }
 
                 droot->childs[i] = dnode1;
@@ -2071,6 +2251,9 @@ static int arm_insteng_gen_dfa(struct arm_inst_engine *eng)
         }
     }
 
+    dynarray_reset(&stack);
+    free(htab.tab);
+
     return 0;
 }
 
@@ -2079,7 +2262,8 @@ static int arm_insteng_gen_trans2d(struct arm_inst_engine *eng)
     int i;
     struct reg_tree *tree = &eng->dfa;
     struct reg_node *node;
-    eng->width = eng->dfa.counts;
+    /* 节点id 从 0 到 counts，一共 counts + 1 个 */
+    eng->width = eng->dfa.counts + 1;
     eng->height = 2;
 
     eng->trans2d = calloc(1, eng->width * eng->height * sizeof (eng->trans2d[0]));
@@ -2107,21 +2291,103 @@ static int arm_insteng_gen_trans2d(struct arm_inst_engine *eng)
     return 0;
 }
 
-static int arm_insteng_init(struct arm_emu *emu)
+static int arm_insteng_walk(struct arm_inst_engine *eng, int from, int bits, int n)
 {
-    int i, j, k, m, n, len;
-    const char *exp;
-    char buf[128];
+    int j;
 
-    if (g_eng)
+    /* 根节点的id是0，所以0既是起始状态，也表示走不下去了 */
+    for (j = n - 1; j >= 0; j--) {
+        from = eng->trans2d[eng->width * ((bits >> j) & 1) + from];
+        if (!from)
+            break;
+    }
+
+    return from;
+}
+
+static int arm_insteng_lut_leaf(struct arm_inst_engine *eng, int *leaf_of, int id)
+{
+    struct reg_node *node = (struct reg_node *)eng->dfa.arr.ptab[id];
+
+    if (!id || !node->func)
         return 0;
 
-    g_eng = calloc(1, sizeof (g_eng[0]));
-    if (!g_eng)
-        vm_error("arm_insteng_init() calloc failure");
+    if (!leaf_of[id]) {
+        dynarray_add(&eng->leafs, node);
+        leaf_of[id] = eng->leafs.len;
+    }
+
+    return leaf_of[id];
+}
+
+static int arm_insteng_lut_row(struct arm_inst_engine *eng, int *row_of, int *leaf_of, int id, int depth)
+{
+    struct reg_node *node = (struct reg_node *)eng->dfa.arr.ptab[id];
+    int row, b, to;
+
+    if (!id || (!node->childs[0] && !node->childs[1] && !node->childs[2]))
+        return 0;
+
+    if (row_of[id])
+        return row_of[id];
+
+    row = eng->lut8_rows++;
+    eng->lut8 = realloc(eng->lut8, eng->lut8_rows * sizeof (eng->lut8[0]));
+    if (!eng->lut8)
+        vm_error("arm_insteng_lut_row() realloc failure");
+    row_of[id] = row + 1;
+
+    for (b = 0; b < 256; b++) {
+        to = arm_insteng_walk(eng, id, b, 8);
+        /* 递归的时候 eng->lut8 可能会被realloc，所以不要提前取行指针 */
+        if (depth == 16)
+            to = arm_insteng_lut_row(eng, row_of, leaf_of, to, depth + 8);
+        else
+            to = arm_insteng_lut_leaf(eng, leaf_of, to);
 
-    dynarray_add(&g_eng->enfa.arr, &g_eng->enfa.root);
-    dynarray_add(&g_eng->dfa.arr, &g_eng->dfa.root);
+        eng->lut8[row][b] = to;
+    }
+
+    return row + 1;
+}
+
+/* 从DFA生成两级查找表 */
+static int arm_insteng_gen_lut(struct arm_inst_engine *eng)
+{
+    int *row_of, *leaf_of, h, to;
+
+    row_of = calloc(eng->width * 2, sizeof (row_of[0]));
+    if (!row_of)
+        vm_error("arm_insteng_gen_lut() calloc failure");
+    leaf_of = row_of + eng->width;
+
+    eng->lut16 = calloc(65536, sizeof (eng->lut16[0]));
+    if (!eng->lut16)
+        vm_error("arm_insteng_gen_lut() calloc failure");
+
+    for (h = 0; h < 65536; h++) {
+        to = arm_insteng_walk(eng, 0, h, 16);
+        if (!to)
+            continue;
+
+        eng->lut16[h].leaf = arm_insteng_lut_leaf(eng, leaf_of, to);
+        eng->lut16[h].row = arm_insteng_lut_row(eng, row_of, leaf_of, to, 16);
+    }
+
+    free(row_of);
+
+    return 0;
+}
+
+/* 从 desclist 构造NFA，然后生成DFA和跳转表 */
+static int arm_insteng_build(struct arm_inst_engine *eng, struct arm_emu *emu)
+{
+    int i, j, k, m, n, len;
+    const char *exp;
+    char buf[128];
+
+    dynarray_add(&eng->enfa.arr, &eng->enfa.root);
+    dynarray_add(&eng->dfa.arr, &eng->dfa.root);
 
     for (i = 0; i < count_of_array(desclist); i++) {
         exp = desclist[i].regexp;
@@ -2141,7 +2407,7 @@ static int arm_insteng_init(struct arm_emu *emu)
                     }
 
                     strcpy(buf + k + bits, exp + j);
-                    arm_insteng_add_exp(g_eng, buf, desclist[i].desc[n], desclist[i].funclist[n]);
+                    arm_insteng_add_exp(eng, buf, i, n);
                 }
                 break;
             }
@@ -2152,24 +2418,182 @@ static int arm_insteng_init(struct arm_emu *emu)
         buf[k] = 0;
 
         if (j == len)
-            arm_insteng_add_exp(g_eng, buf, desclist[i].desc[0], desclist[i].funclist[0]);
+            arm_insteng_add_exp(eng, buf, i, 0);
+    }
+
+    if (emu && emu->dump.nfa) {
+        sprintf(buf, "%s/nfa.dot", emu->filename);
+        reg_node_dump_dot(buf, &eng->enfa);
     }
 
-    sprintf(buf, "%s/nfa.dot", emu->filename);
-    reg_node_dump_dot(buf, &g_eng->enfa);
+    arm_insteng_gen_dfa(eng);
+
+    if (emu && emu->dump.dfa) {
+        sprintf(buf, "%s/dfa.dot", emu->filename);
+        reg_node_dump_dot(buf, &eng->dfa);
+    }
 
-    arm_insteng_gen_dfa(g_eng);
+    arm_insteng_gen_trans2d(eng);
 
-    sprintf(buf, "%s/dfa.dot", emu->filename);
-    reg_node_dump_dot(buf, &g_eng->dfa);
+    return 0;
+}
 
-    arm_insteng_gen_trans2d(g_eng);
+/* desclist 的指纹(FNV-1a)：每一项的模式串，和 funclist 里每个位置有没有函数、对应的助记符。
+生成的表里记的是 desclist 的下标和 funclist 的下标，改了模式、调了顺序，数量不变也能查出来 */
+static unsigned int arm_insteng_desclist_hash(void)
+{
+    unsigned int h = 2166136261u;
+    const char *p;
+    int i, j;
+
+#define fnv1a(c)        (h = (h ^ (unsigned char)(c)) * 16777619u)
+    for (i = 0; i < count_of_array(desclist); i++) {
+        for (p = desclist[i].regexp; *p; p++) fnv1a(*p);
+        fnv1a(0);
+        for (j = 0; j < 4; j++) {
+            fnv1a(desclist[i].funclist[j] ? 1 : 0);
+            for (p = desclist[i].desc[j]; p && *p; p++) fnv1a(*p);
+            fnv1a(0);
+        }
+    }
+#undef fnv1a
+
+    return h;
+}
+
+#if defined(ARM_INSTENG_PREBUILT)
+/* 由 armgen 在构建时生成 */
+#include "arm_insteng_tbl.h"
+
+/* 直接使用构建时生成的查找表，启动时不需要再构造NFA和DFA */
+static int arm_insteng_load_tbl(struct arm_inst_engine *eng)
+{
+    const struct arm_inst_tbl_leaf *leaf;
+    struct reg_node *nodes;
+    int i;
+
+    if ((ARM_INSTENG_TBL_DESCLIST_NUM != count_of_array(desclist))
+        || (ARM_INSTENG_TBL_DESCLIST_HASH != arm_insteng_desclist_hash()))
+        vm_error("arm_insteng_tbl.h is out of date with desclist, please rebuild armgen");
+
+    nodes = calloc(count_of_array(arm_insteng_tbl_leafs), sizeof (nodes[0]));
+    if (!nodes)
+        vm_error("arm_insteng_load_tbl() calloc failure");
+
+    for (i = 0; i < count_of_array(arm_insteng_tbl_leafs); i++) {
+        leaf = &arm_insteng_tbl_leafs[i];
+
+        nodes[i].id = i + 1;
+        nodes[i].func = desclist[leaf->desc_idx].funclist[leaf->func_idx];
+        nodes[i].exp = (char *)leaf->exp;
+        nodes[i].desc = (char *)leaf->desc;
+        nodes[i].prog = &leaf->prog;
+        nodes[i].desc_idx = leaf->desc_idx;
+        nodes[i].func_idx = leaf->func_idx;
+        dynarray_add(&eng->leafs, &nodes[i]);
+    }
+
+    /* 生成的表是只读的，这里只是为了和运行时生成的表共用一个字段 */
+    eng->lut16 = (struct arm_inst_lut16 *)arm_insteng_tbl_lut16;
+    eng->lut8 = (unsigned short (*)[256])arm_insteng_tbl_lut8;
+    eng->lut8_rows = count_of_array(arm_insteng_tbl_lut8);
+
+    return 0;
+}
+#endif
+
+static int arm_insteng_init(struct arm_emu *emu)
+{
+    if (g_eng)
+        return 0;
+
+    g_eng = calloc(1, sizeof (g_eng[0]));
+    if (!g_eng)
+        vm_error("arm_insteng_init() calloc failure");
+
+#if defined(ARM_INSTENG_PREBUILT)
+    arm_insteng_load_tbl(g_eng);
+
+    /* 校验查找表时还是需要DFA */
+    if (ARM_INSTENG_LUT_CHECK)
+        arm_insteng_build(g_eng, emu);
+#else
+    arm_insteng_build(g_eng, emu);
+    arm_insteng_gen_lut(g_eng);
+#endif
 
     init_inst_map = 1;
 
     return 0;
 }
 
+static void arm_insteng_gen_str(FILE *fp, const char *str)
+{
+    fputc('"', fp);
+    for (; *str; str++) {
+        if ((*str == '"') || (*str == '\\'))
+            fputc('\\', fp);
+        fputc(*str, fp);
+    }
+    fputc('"', fp);
+}
+
+int arm_insteng_gen_source(const char *filename)
+{
+    const struct arm_inst_prog *prog;
+    struct reg_node *node;
+    FILE *fp;
+    int i, j;
+
+    arm_insteng_init(NULL);
+
+    fp = fopen(filename, "w");
+    if (!fp)
+        vm_error("arm_insteng_gen_source() open file[%s] failure", filename);
+
+    fprintf(fp, "/* generated by armgen from desclist in arm_emu.c, do not edit */\n\n");
+    fprintf(fp, "#define ARM_INSTENG_TBL_DESCLIST_NUM    %d\n", (int)count_of_array(desclist));
+    fprintf(fp, "#define ARM_INSTENG_TBL_DESCLIST_HASH   0x%08xu\n\n", arm_insteng_desclist_hash());
+
+    fprintf(fp, "static const struct arm_inst_tbl_leaf arm_insteng_tbl_leafs[%d] = {\n", g_eng->leafs.len);
+    for (i = 0; i < g_eng->leafs.len; i++) {
+        node = (struct reg_node *)g_eng->leafs.ptab[i];
+        prog = node->prog;
+
+        fprintf(fp, "    { %d, %d, ", node->desc_idx, node->func_idx);
+        arm_insteng_gen_str(fp, node->exp);
+        fprintf(fp, ", ");
+        arm_insteng_gen_str(fp, node->desc);
+        fprintf(fp, ", { %d, {", prog->num);
+        for (j = 0; j < prog->num; j++) {
+            fprintf(fp, "%s{%d,%d,%d,%d,0x%x}", j ? ", " : " ", prog->ops[j].field, prog->ops[j].half,
+                prog->ops[j].shift, prog->ops[j].bias, prog->ops[j].mask);
+        }
+        fprintf(fp, " } } },\n");
+    }
+    fprintf(fp, "};\n\n");
+
+    fprintf(fp, "static const struct arm_inst_lut16 arm_insteng_tbl_lut16[65536] = {\n");
+    for (i = 0; i < 65536; i++) {
+        fprintf(fp, "%s{%d,%d},%s", (i % 8) ? "" : "    ", g_eng->lut16[i].leaf, g_eng->lut16[i].row, ((i % 8) == 7) ? "\n" : " ");
+    }
+    fprintf(fp, "};\n\n");
+
+    fprintf(fp, "static const unsigned short arm_insteng_tbl_lut8[%d][256] = {\n", g_eng->lut8_rows);
+    for (i = 0; i < g_eng->lut8_rows; i++) {
+        fprintf(fp, "    {\n");
+        for (j = 0; j < 256; j++) {
+            fprintf(fp, "%s%d,%s", (j % 16) ? "" : "        ", g_eng->lut8[i][j], ((j % 16) == 15) ? "\n" : " ");
+        }
+        fprintf(fp, "    },\n");
+    }
+    fprintf(fp, "};\n");
+
+    fclose(fp);
+
+    return 0;
+}
+
 static int arm_insteng_uninit()
 {
 }
@@ -2185,16 +2609,19 @@ static void arm_inst_ctx_init(struct arm_inst_ctx *ctx)
 
 static void arm_liveness_init(struct arm_emu *emu, struct minst *minst, struct arm_inst_ctx *ctx)
 {
-    if (ctx->ld >= 0) {
-        live_def_set(&emu->mblk, ctx->ld);
-    }
+    /* 这几个寄存器只和指令编码有关，第一次解码时设置过就不用再设置了 */
+    if (!minst->flag.decoded) {
+        if (ctx->ld >= 0) {
+            live_def_set(&emu->mblk, ctx->ld);
+        }
 
-    if (ctx->lm >= 0) {
-        live_use_set(&emu->mblk, ctx->lm);
-    }
+        if (ctx->lm >= 0) {
+            live_use_set(&emu->mblk, ctx->lm);
+        }
 
-    if (ctx->ln >= 0) {
-        live_use_set(&emu->mblk, ctx->ln);
+        if (ctx->ln >= 0) {
+            live_use_set(&emu->mblk, ctx->ln);
+        }
     }
 
     /* FIXME，这一句有问题，我在处理IT指令的时候，生成2个cfg，出了当前的IT指令会使用APSR，
@@ -2204,7 +2631,7 @@ static void arm_liveness_init(struct arm_emu *emu, struct minst *minst, struct a
     }
 }
 
-static struct reg_node*     arm_insteng_parse(uint8_t *code, int len, int *olen)
+static struct reg_node*     arm_insteng_dfa_parse(uint8_t *code, int len, int *olen)
 {
     struct reg_node *node = NULL, *p_end_node = NULL;
     int i, j, from = 0, to, bit;
@@ -2247,6 +2674,292 @@ static struct reg_node*     arm_insteng_parse(uint8_t *code, int len, int *olen)
     return node;
 }
 
+/* 查表解码，第一个半字查一次，thumb32的第二个半字再按字节查两次，
+找不到时返回NULL，不报错，预解码线程里也会调用 */
+static struct reg_node*     arm_insteng_lut_lookup(uint8_t *code, int *olen)
+{
+    uint16_t *inst = (uint16_t *)code;
+    struct arm_inst_lut16 *ent = &g_eng->lut16[inst[0]];
+    int row, leaf = 0, i = 1;
+
+    /* 和DFA一样，采取最长匹配原则 */
+    if (ent->row && (row = g_eng->lut8[ent->row - 1][inst[1] >> 8])
+        && (leaf = g_eng->lut8[row - 1][inst[1] & 0xff])) {
+        i = 2;
+    }
+    else if (!(leaf = ent->leaf)) {
+        return NULL;
+    }
+
+    if (olen)
+        *olen = i;
+
+    return (struct reg_node *)g_eng->leafs.ptab[leaf - 1];
+}
+
+static struct reg_node*     arm_insteng_lut_parse(uint8_t *code, int len, int *olen)
+{
+    struct reg_node *node = arm_insteng_lut_lookup(code, olen);
+
+    if (!node)
+        vm_error("arm_insteng_parse() meet unkown instruction, code[%02x %02x]", code[0], code[1]);
+
+    return node;
+}
+
+static struct reg_node*     arm_insteng_parse(uint8_t *code, int len, int *olen)
+{
+    struct reg_node *node = arm_insteng_lut_parse(code, len, olen);
+
+#if ARM_INSTENG_LUT_CHECK
+    int i, i1;
+    struct reg_node *node1 = arm_insteng_dfa_parse(code, len, &i1);
+
+    arm_insteng_lut_parse(code, len, &i);
+    if (strcmp(node->exp, node1->exp) || (i != i1))
+        vm_error("arm_insteng_parse() lookup table[%s:%d] mismatch dfa[%s:%d], code[%02x %02x %02x %02x]",
+            node->desc, i, node1->desc, i1, code[0], code[1], code[2], code[3]);
+#endif
+
+    return node;
+}
+
+/* 预解码
+
+thumb指令的长度只由第一个半字的高5位决定，0b11101/0b11110/0b11111 是32位指令，其余都是
+16位，所以可以先把所有半字分类，再做线性扫描找出指令边界。
+
+把代码切成几块，每块一个线程。块的起点不一定是指令边界(可能落在上一块最后一条32位指令
+的中间)，所以每块从 start 和 start+1 两个相位各扫一遍，扫完以后按顺序把上一块的出口
+接到下一块的入口上，选中对应的相位，然后再多线程查表解码选中的边界。
+
+这里只做解码，指令的执行(it块，data_mark等)依赖前面的状态，还是在 first pass 里顺序做，
+minst 也是那时候按地址顺序创建的，所以 allinst 的顺序和原来一样。 */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define ARM_PREDECODE_SSE2          1
+#else
+#define ARM_PREDECODE_SSE2          0
+#endif
+
+#ifndef ARM_PREDECODE_MIN_LEN
+/* 小于这个长度的函数直接顺序解码，开线程不划算 */
+#define ARM_PREDECODE_MIN_LEN       (256 * KB)
+#endif
+#define ARM_PREDECODE_CHUNK_MIN     (64 * KB)
+#define ARM_PREDECODE_THREADS_MAX   16
+
+struct arm_predecode_chunk {
+    const uint16_t              *hw;
+    int                         hw_num;
+    uint8_t                     *is32;
+    uint8_t                     *bound[2];
+
+    /* 半字下标 [start, end) */
+    int                         start;
+    int                         end;
+    /* 从两个相位扫描后停下来的半字下标 */
+    int                         exit[2];
+    int                         phase;
+    /* 0: 分类+扫描 1: 解码 */
+    int                         stage;
+
+    struct arm_predecode_inst   *tab;
+    int                         num;
+};
+
+static void arm_predecode_classify(const uint16_t *hw, uint8_t *is32, int n)
+{
+    int i = 0;
+
+#if ARM_PREDECODE_SSE2
+    /* 右移11位后和 0b11100 比较，一次处理16个半字 */
+    const __m128i top = _mm_set1_epi16(0x1c);
+    const __m128i one = _mm_set1_epi8(1);
+
+    for (; i + 16 <= n; i += 16) {
+        __m128i a = _mm_srli_epi16(_mm_loadu_si128((const __m128i *)(hw + i)), 11);
+        __m128i b = _mm_srli_epi16(_mm_loadu_si128((const __m128i *)(hw + i + 8)), 11);
+        __m128i c = _mm_packs_epi16(_mm_cmpgt_epi16(a, top), _mm_cmpgt_epi16(b, top));
+
+        _mm_storeu_si128((__m128i *)(is32 + i), _mm_and_si128(c, one));
+    }
+#endif
+
+    for (; i < n; i++)
+        is32[i] = (hw[i] & 0xf800) >= 0xe800;
+}
+
+static int arm_predecode_sweep(const uint8_t *is32, uint8_t *bound, int i, int end)
+{
+    while (i < end) {
+        bound[i] = 1;
+        i += 1 + is32[i];
+    }
+
+    return i;
+}
+
+static void arm_predecode_chunk_decode(struct arm_predecode_chunk *c)
+{
+    uint8_t *bound = c->bound[c->phase];
+    struct arm_predecode_inst *pi;
+    int i, l;
+
+    for (i = c->start, c->num = 0; i < c->end; i++)
+        c->num += bound[i];
+
+    if (!c->num)
+        return;
+
+    c->tab = calloc(c->num, sizeof (c->tab[0]));
+    if (!c->tab)
+        vm_error("arm_predecode_chunk_decode() failed with calloc");
+
+    for (i = c->start, pi = c->tab; i < c->end; i++) {
+        if (!bound[i])
+            continue;
+
+        pi->offset = i * 2;
+        pi->len = (1 + c->is32[i]) * 2;
+        /* 最后一个半字查表会读越界，留给顺序解码处理 */
+        if ((i + 1 < c->hw_num) && (pi->node = arm_insteng_lut_lookup((uint8_t *)(c->hw + i), &l))
+            && (l * 2 != pi->len))
+            pi->node = NULL;
+        pi++;
+    }
+}
+
+static mthread_ret MTHREAD_API arm_predecode_thread(void *arg)
+{
+    struct arm_predecode_chunk *c = arg;
+
+    if (c->stage == 0) {
+        arm_predecode_classify(c->hw + c->start, c->is32 + c->start, c->end - c->start);
+        c->exit[0] = arm_predecode_sweep(c->is32, c->bound[0], c->start, c->end);
+        if (c->start)
+            c->exit[1] = arm_predecode_sweep(c->is32, c->bound[1], c->start + 1, c->end);
+    }
+    else {
+        arm_predecode_chunk_decode(c);
+    }
+
+    return 0;
+}
+
+static void arm_predecode_run(struct arm_predecode_chunk *chunks, int num, int stage)
+{
+    mthread_t tids[ARM_PREDECODE_THREADS_MAX];
+    int i;
+
+    for (i = 0; i < num; i++)
+        chunks[i].stage = stage;
+
+    for (i = 1; i < num; i++) {
+        if (mthread_create(&tids[i], arm_predecode_thread, &chunks[i]))
+            vm_error("arm_predecode_run() failed with create thread");
+    }
+
+    /* 第一块在当前线程做 */
+    arm_predecode_thread(&chunks[0]);
+
+    for (i = 1; i < num; i++)
+        mthread_join(tids[i]);
+}
+
+static void arm_predecode(struct arm_emu *emu, uint8_t *code, int len)
+{
+    struct arm_predecode_chunk chunks[ARM_PREDECODE_THREADS_MAX];
+    uint8_t *buf;
+    int i, n, num, entry;
+
+    emu->predecode.cur = emu->predecode.num = 0;
+    if (ARM_INSTENG_LUT_CHECK || (len < ARM_PREDECODE_MIN_LEN))
+        return;
+
+    if (!g_eng)     arm_insteng_init(emu);
+
+    n = len / 2;
+    num = mthread_cpu_num();
+    if (num > len / ARM_PREDECODE_CHUNK_MIN)
+        num = len / ARM_PREDECODE_CHUNK_MIN;
+    if (num > ARM_PREDECODE_THREADS_MAX)
+        num = ARM_PREDECODE_THREADS_MAX;
+    if (num < 1)
+        num = 1;
+
+    buf = calloc(3, n);
+    if (!buf)
+        vm_error("arm_predecode() failed with calloc");
+
+    memset(chunks, 0, sizeof (chunks));
+    for (i = 0; i < num; i++) {
+        chunks[i].hw = (const uint16_t *)code;
+        chunks[i].hw_num = n;
+        chunks[i].is32 = buf;
+        chunks[i].bound[0] = buf + n;
+        chunks[i].bound[1] = buf + n * 2;
+        chunks[i].start = (int)((long long)n * i / num);
+        chunks[i].end = (int)((long long)n * (i + 1) / num);
+    }
+
+    arm_predecode_run(chunks, num, 0);
+
+    /* 拼接: 上一块的出口就是下一块的入口，最多跨进下一块一个半字 */
+    for (i = entry = 0; i < num; i++) {
+        chunks[i].phase = entry - chunks[i].start;
+        entry = chunks[i].exit[chunks[i].phase];
+    }
+
+    arm_predecode_run(chunks, num, 1);
+
+    for (i = n = 0; i < num; i++)
+        n += chunks[i].num;
+
+    free(emu->predecode.tab);
+    emu->predecode.tab = calloc(n + 1, sizeof (emu->predecode.tab[0]));
+    if (!emu->predecode.tab)
+        vm_error("arm_predecode() failed with calloc");
+
+    for (i = n = 0; i < num; i++) {
+        if (chunks[i].num)
+            memcpy(emu->predecode.tab + n, chunks[i].tab, chunks[i].num * sizeof (chunks[i].tab[0]));
+        n += chunks[i].num;
+        free(chunks[i].tab);
+    }
+
+    emu->predecode.base = code;
+    emu->predecode.len = len;
+    emu->predecode.num = n;
+
+    free(buf);
+}
+
+static struct reg_node*     arm_predecode_get(struct arm_emu *emu, uint8_t *code, int *olen)
+{
+    struct arm_predecode_inst *pi;
+    long off = (long)(code - emu->predecode.base);
+
+    if (!emu->predecode.num || (off < 0) || (off >= emu->predecode.len))
+        return NULL;
+
+    while ((emu->predecode.cur < emu->predecode.num) && (emu->predecode.tab[emu->predecode.cur].offset < off))
+        emu->predecode.cur++;
+
+    if (emu->predecode.cur == emu->predecode.num)
+        return NULL;
+
+    /* data_mark 跳过4字节以后可能落在扫描结果的指令中间，这时回退到顺序解码，
+    后面对齐了还会再用上 */
+    pi = &emu->predecode.tab[emu->predecode.cur];
+    if ((pi->offset != off) || !pi->node)
+        return NULL;
+
+    *olen = pi->len / 2;
+
+    return pi->node;
+}
+
 /*
 
 @return     0       normal success
@@ -2264,7 +2977,11 @@ static int arm_minst_do(struct arm_emu *emu, struct minst *minst)
 
     memcpy(emu->prev_regs, emu->regs, sizeof (emu->regs));
 
-    arm_inst_extract_ctx(&emu->code.ctx, reg_node->exp, minst->addr, minst->len);
+    /* 各个分析pass会反复执行同一条指令，只在第一次执行时解码，handler会修改 emu->code.ctx，
+    所以每次都从缓存里拷贝一份 */
+    if (!minst->flag.decoded)
+        arm_inst_prog_exec(&minst->ctx, reg_node->prog, minst->addr, minst->len);
+    emu->code.ctx = minst->ctx;
 
     /* 不要挪动位置，假如你把他移动到 reg_node->func 后面，会导致 it 也被判断为在 it_block 中 */
     if (InITBlock(emu)) {
@@ -2275,6 +2992,7 @@ static int arm_minst_do(struct arm_emu *emu, struct minst *minst)
     }
 
     arm_liveness_init(emu, minst, &emu->code.ctx);
+    minst->flag.decoded = 1;
 
     ret = reg_node->func(emu, minst, (uint16_t *)minst->addr, minst->len / 2);
 
@@ -2296,10 +3014,14 @@ static int arm_insteng_decode(struct arm_emu *emu, uint8_t *code, int len)
     if (bitset_get(&emu->data_mark, (unsigned)(code - emu->elf.data) >> 2))
         return 4;
 
-    struct reg_node *node = arm_insteng_parse(code, len, &i);
+    struct reg_node *node = arm_predecode_get(emu, code, &i);
+    if (!node)
+        node = arm_insteng_parse(code, len, &i);
     minst = minst_new(&emu->mblk, code, i * 2, node);
 
+    emu->dump.inst = 1;
     arm_minst_do(emu, minst);
+    emu->dump.inst = 0;
 
     if (emu->prev_minst && !minst_is_b(emu->prev_minst)) {
         minst_add_edge(emu->prev_minst, minst);
@@ -2313,14 +3035,31 @@ static int arm_insteng_decode(struct arm_emu *emu, uint8_t *code, int len)
     return i * 2;
 }
 
-int arm_inst_extract_ctx(struct arm_inst_ctx *ctx, const char *oexp, uint8_t *code, int code_len)
+static void arm_inst_prog_add(struct arm_inst_prog *prog, const char *oexp, int field, int i, int len, int bias)
 {
-    const char *exp = oexp;
-    int i, len, c, b, d = 0;
+    struct arm_inst_field_op *op;
 
-    arm_inst_ctx_init(ctx);
+    if (prog->num >= ARM_INST_FIELD_MAX)
+        vm_error("inst exp [%s], too many fields\n", oexp);
 
-    uint16_t inst = *(uint16_t *)code;
+    /* 字段不允许跨半字 */
+    if ((i & 15) + len > 16)
+        vm_error("inst exp [%s], field cross halfword\n", oexp);
+
+    op = &prog->ops[prog->num++];
+    op->field = field;
+    op->half = i / 16;
+    op->shift = 16 - (i & 15) - len;
+    op->mask = (1 << len) - 1;
+    op->bias = bias;
+}
+
+static int arm_inst_prog_compile(struct arm_inst_prog *prog, const char *oexp)
+{
+    const char *exp = oexp;
+    int i, len, c, field;
+
+    memset(prog, 0, sizeof (prog[0]));
 
     i = 0;
     while(*exp) {
@@ -2341,16 +3080,17 @@ int arm_inst_extract_ctx(struct arm_inst_ctx *ctx, const char *oexp, uint8_t *co
         case 'w':
         case 'p':
             len = atoi(++exp);
-            b = BITS_GET(inst, 16 - i - len, len);
 
-            if (c == 's') ctx->setflags = b;
-            else if (c == 't') ctx->t = b;
-            else if (c == 'i') ctx->imm = b;
-            else if (c == 'u') ctx->u = b;
-            else if (c == 'w') ctx->w = b;
-            else if (c == 'p') ctx->p = b;
-            else if (c == 'd') d = b;
-            else ctx->cond = b;
+            if (c == 's') field = ARM_FIELD_S;
+            else if (c == 't') field = ARM_FIELD_T;
+            else if (c == 'i') field = ARM_FIELD_I;
+            else if (c == 'u') field = ARM_FIELD_U;
+            else if (c == 'w') field = ARM_FIELD_W;
+            else if (c == 'p') field = ARM_FIELD_P;
+            else if (c == 'd') field = ARM_FIELD_D;
+            else field = ARM_FIELD_C;
+
+            arm_inst_prog_add(prog, oexp, field, i, len, 0);
 
             while (isdigit(*exp)) exp++;
             i += len;
@@ -2359,7 +3099,7 @@ int arm_inst_extract_ctx(struct arm_inst_ctx *ctx, const char *oexp, uint8_t *co
 
         case 'm':
             len = 1;
-            ctx->m = BITS_GET(inst, 16 - i - len, len);
+            arm_inst_prog_add(prog, oexp, ARM_FIELD_M, i, len, 0);
             exp += 2; i += len;
             break;
 
@@ -2369,32 +3109,16 @@ int arm_inst_extract_ctx(struct arm_inst_ctx *ctx, const char *oexp, uint8_t *co
             exp++;
             len = atoi(exp + 1);
             switch (*exp++) {
-            case 'n':
-                ctx->ln = BITS_GET(inst, 16 - i - len, len) + (c == 'h') * 8;
-                break;
-
-            case 'm':
-                ctx->lm = BITS_GET(inst, 16 - i - len, len) + (c == 'h') * 8;
-                break;
-
-            case 'p':
-                ctx->lp = BITS_GET(inst, 16 - i - len, len) + (c == 'h') * 8;
-                break;
-
-            case 'd':
-                if (c == 'v')
-                    ctx->vd = BITS_GET(inst, 16 - i - len, len) + d * 16;
-                else
-                    ctx->ld = BITS_GET(inst, 16 - i - len, len) + (c == 'h') * 8 + d * 8;
-                break;
-
-            case 'e':
-                ctx->ld2 = BITS_GET(inst, 16 - i - len, len) + (c == 'h') * 8;
-                break;
-
+            case 'n': field = ARM_FIELD_LN; break;
+            case 'm': field = ARM_FIELD_LM; break;
+            case 'p': field = ARM_FIELD_LP; break;
+            case 'd': field = (c == 'v') ? ARM_FIELD_VD : ARM_FIELD_LD; break;
+            case 'e': field = ARM_FIELD_LE; break;
             default:
                 goto fail_label;
             }
+            /* vd 的高位由 d 给出，不需要加 8 */
+            arm_inst_prog_add(prog, oexp, field, i, len, ((c == 'h') && (field != ARM_FIELD_VD)) * 8);
             i += len;
 
             while (isdigit(*exp)) exp++;
@@ -2404,7 +3128,7 @@ int arm_inst_extract_ctx(struct arm_inst_ctx *ctx, const char *oexp, uint8_t *co
             exp++;
             if (*exp == 'l') {
                 len = atoi(++exp);
-                ctx->register_list |= BITS_GET(inst, 16 - i - len, len);
+                arm_inst_prog_add(prog, oexp, ARM_FIELD_RL, i, len, 0);
             }
             else
                 goto fail_label;
@@ -2417,12 +3141,71 @@ int arm_inst_extract_ctx(struct arm_inst_ctx *ctx, const char *oexp, uint8_t *co
             vm_error("inst exp [%s], un-expect token[%s]\n", oexp, exp);
             break;
         }
+    }
+
+    return 0;
+}
+
+static void arm_inst_prog_exec(struct arm_inst_ctx *ctx, const struct arm_inst_prog *prog, uint8_t *code, int code_len)
+{
+    const struct arm_inst_field_op *op, *end = prog->ops + prog->num;
+    uint16_t inst[2];
+    int b, d = 0;
 
-        if ((i == 16) && (code_len == 4)) {
-            i = 0;
-            inst = *(uint16_t *)(code + 2);
+    arm_inst_ctx_init(ctx);
+
+    inst[0] = ((uint16_t *)code)[0];
+    inst[1] = (code_len == 4) ? ((uint16_t *)code)[1] : inst[0];
+
+    for (op = prog->ops; op < end; op++) {
+        b = ((inst[op->half] >> op->shift) & op->mask) + op->bias;
+
+        switch (op->field) {
+        case ARM_FIELD_S:   ctx->setflags = b; break;
+        case ARM_FIELD_T:   ctx->t = b; break;
+        case ARM_FIELD_I:   ctx->imm = b; break;
+        case ARM_FIELD_C:   ctx->cond = b; break;
+        case ARM_FIELD_D:   d = b; break;
+        case ARM_FIELD_U:   ctx->u = b; break;
+        case ARM_FIELD_W:   ctx->w = b; break;
+        case ARM_FIELD_P:   ctx->p = b; break;
+        case ARM_FIELD_M:   ctx->m = b; break;
+        case ARM_FIELD_LN:  ctx->ln = b; break;
+        case ARM_FIELD_LM:  ctx->lm = b; break;
+        case ARM_FIELD_LP:  ctx->lp = b; break;
+        case ARM_FIELD_LD:  ctx->ld = b + d * 8; break;
+        case ARM_FIELD_LE:  ctx->ld2 = b; break;
+        case ARM_FIELD_VD:  ctx->vd = b + d * 16; break;
+        case ARM_FIELD_RL:  ctx->register_list |= b; break;
         }
     }
+}
+
+int arm_inst_decode(struct arm_inst_ctx *ctx, uint8_t *code, int code_len)
+{
+    struct reg_node *node;
+    int i;
+
+    if (!g_eng)     arm_insteng_init(NULL);
+
+    /* 32位指令只剩一个半字了，查表会读越界 */
+    if ((code_len < 2) || ((code_len < 4) && ((((uint16_t *)code)[0] & 0xf800) >= 0xe800)))
+        return 0;
+
+    if (!(node = arm_insteng_lut_lookup(code, &i)) || (i * 2 > code_len))
+        return 0;
+
+    arm_inst_prog_exec(ctx, node->prog, code, i * 2);
+
+    return i * 2;
+}
+
+int arm_inst_extract_ctx(struct arm_inst_ctx *ctx, const char *oexp, uint8_t *code, int code_len)
+{
+    struct arm_inst_prog prog;
+
+    arm_inst_prog_compile(&prog, oexp);
+    arm_inst_prog_exec(ctx, &prog, code, code_len);
 
     return 0;
 }
@@ -2459,7 +3242,11 @@ struct arm_emu   *arm_emu_create(struct arm_emu_create_param *param)
 
     bitset_init(&emu->data_mark, emu->elf.len >> 2);
     sprintf(buf, "sub_%x", emu->code.data - emu->elf.data);
-    minst_blk_init(&emu->mblk, buf, arm_minst_do, emu);
+    minst_blk_init(&emu->mblk, buf, (minst_parse_callback)arm_minst_do, emu);
+    emu->mblk.bcond_do = arm_emu_minst_cond;
+    emu->mblk.pure_do = arm_emu_minst_pure;
+    emu->mblk.fields_do = arm_emu_minst_fields;
+    emu->mblk.rename_do = arm_emu_minst_rename;
 
     sprintf(buf, "%s/%s", emu->filename, emu->mblk.funcname);
     mdir_make(buf);
@@ -2486,6 +3273,7 @@ void        arm_emu_destroy(struct arm_emu *e)
 
     minst_blk_uninit(&e->mblk);
     bitset_uninit(&e->data_mark);
+    free(e->predecode.tab);
     free(e);
 }
 
@@ -2498,9 +3286,13 @@ static int arm_emu_dump_mblk(struct arm_emu *emu, char *postfix)
     sprintf(buf, "%s/%s/inst_%s.txt", emu->filename, emu->mblk.funcname, postfix);
     FILE *fp = fopen(buf, "w");
 
+    /* 优化过程只查 SSA，到达定值的位矩阵只在dump的时候算一次 */
+    minst_blk_gen_reaching_definitions(&emu->mblk);
+
     arm_emu_cpu_reset(emu);
     EMU_SET_CONST_MODE(emu);
     emu->decode_inst_flag = FLAG_DISABLE_EMU;
+    emu->dump.inst = 1;
     for (i = 0; i < emu->mblk.allinst.len; i++) {
         minst = emu->mblk.allinst.ptab[i];
 
@@ -2511,6 +3303,7 @@ static int arm_emu_dump_mblk(struct arm_emu *emu, char *postfix)
         fprintf(fp, buf);
         fprintf(fp, "\n");
     }
+    emu->dump.inst = 0;
     fclose(fp);
 
     return 0;
@@ -2560,7 +3353,9 @@ static void arm_emu_dump_cfg(struct arm_emu *emu, char *postfix)
         fprintf(fp, "sub_%x [label=<<font color='red'><b>sub_%x(%d, %d)</b></font><br/>", 
             CFG_NODE_ID(cfg->start->addr), CFG_NODE_ID(cfg->start->addr), cfg->id, cfg->csm);
         for (succ = cfg->start; succ; succ = succ->succs.minst) {
+            emu->dump.inst = 1;
             arm_minst_do(emu, succ);
+            emu->dump.inst = 0;
 
             arm_inst_print_format(emu, succ, IDUMP_STATUS, obuf);
 
@@ -2677,15 +3472,19 @@ int         arm_emu_run_once(struct arm_emu *emu, struct minst_blk *blk)
     /* third pass */
     minst_blk_liveness_calc(&emu->mblk);
 
-    minst_blk_gen_reaching_definitions(&emu->mblk);
+    minst_blk_ssa_update(&emu->mblk);
 
     minst_blk_const_propagation(emu, 1);
 
+    minst_blk_out_of_order(&emu->mblk);
+
     arm_emu_dump_cfg(emu, "new");
     arm_emu_dump_mblk(emu, "orig");
 
     arm_emu_reduce_csm(emu);
 
+    minst_blk_coalesce(&emu->mblk);
+
     arm_emu_dump_mblk(emu, "finial");
 
     return 0;
@@ -2723,8 +3522,7 @@ int         arm_emu_trace_csm(struct arm_emu *emu, struct minst *def_m, int trac
     struct minst_blk *blk = &emu->mblk;
     struct minst *minst, *jmp = NULL, *t, *n, *false_m, *true_m;
     struct minst_cfg *cfg, *cfg1;
-    int ret, i, binlen, trace_start, tconst_times = 0;
-    char bincode[32];
+    int ret, i, trace_start, tconst_times = 0;
 
     if (def_m->flag.dead_code) return -1;
 
@@ -2821,8 +3619,7 @@ int         arm_emu_trace_csm(struct arm_emu *emu, struct minst *def_m, int trac
             if (!cfg->start)    cfg->start = n;
         }
         /* cfg末尾需要添加一条实际的jmp指令 */
-        arm_asm2bin(bincode, &binlen, "b");
-        t = minst_new_t(cfg, mtype_b, arm_insteng_parse(bincode, binlen, NULL),  bincode, binlen);
+        t = arm_minst_new_b(cfg, mtype_b);
         cfg->end = t;
 
         t = blk->trace[trace_start - 1];
@@ -2854,9 +3651,8 @@ int minst_csm_expand_add(struct arm_emu *emu, struct minst_blk *blk, struct mins
 {
     struct minst_cfg *parent_cfg, *root_cfg, *cfg;
     struct minst *cmp, *t;
-    int free_reg, i, j, is_end, binlen, changed = 0, inst_start = blk->allinst.len;
+    int free_reg, i, j, is_end, changed = 0, inst_start = blk->allinst.len;
     struct dynarray d = {0};
-    char bincode[8];
 
     if (minst_get_all_const_definition2(blk, m, def, &d)) {
         vm_error("%d inst definition not is const\n", m->id);
@@ -2885,23 +3681,15 @@ int minst_csm_expand_add(struct arm_emu *emu, struct minst_blk *blk, struct mins
 
         {
             cfg = minst_cfg_new(&emu->mblk, NULL, NULL);
-            if (j == 0) {
-                arm_asm2bin(bincode, &binlen, "mov r%d, r%d", free_reg, def);
-                minst_new_t(cfg, mtype_ldr, arm_insteng_parse(bincode, binlen, NULL), bincode, binlen);
-            }
-
-            arm_asm2bin(bincode, &binlen, "movw r%d, 0x%x", def, t->ld_imm & 0xffff);
-            minst_new_t(cfg, mtype_cmp, arm_insteng_parse(bincode, binlen, NULL),  bincode, binlen);
+            if (j == 0)
+                arm_minst_new_mov(cfg, mtype_ldr, free_reg, def);
 
-            arm_asm2bin(bincode, &binlen, "movt r%d, 0x%x", def, (t->ld_imm >> 16) & 0xffff);
-            minst_new_t(cfg, mtype_cmp, arm_insteng_parse(bincode, binlen, NULL),  bincode, binlen);
+            arm_minst_new_movw(cfg, mtype_cmp, def, t->ld_imm & 0xffff);
+            arm_minst_new_movt(cfg, mtype_cmp, def, (t->ld_imm >> 16) & 0xffff);
 
             if (!is_end) {
-                arm_asm2bin(bincode, &binlen, "cmp r%d, r%d", free_reg , def);
-                minst_new_t(cfg, mtype_cmp, arm_insteng_parse(bincode, binlen, NULL),  bincode, binlen);
-
-                arm_asm2bin(bincode, &binlen, "beq");
-                minst_new_t(cfg, 0, arm_insteng_parse(bincode, binlen, NULL),  bincode, binlen);
+                arm_minst_new_cmp(cfg, mtype_cmp, free_reg, def);
+                arm_minst_new_bcond(cfg, 0, ARM_COND_EQ);
             }
         }
 
@@ -2939,8 +3727,7 @@ int minst_csm_expand2(struct arm_emu *emu, struct minst_blk *blk)
     struct minst *pred;
     struct minst_cfg *csm = blk->csm.cfg;
     int changed;
-    BITSET_INIT(defs);
-    BITSET_INIT(defs2);
+    struct bitset *defs = minst_blk_scratch_get(blk), *defs2 = minst_blk_scratch_get(blk);
 
     changed = 1;
     while (changed) {
@@ -2948,9 +3735,8 @@ int minst_csm_expand2(struct arm_emu *emu, struct minst_blk *blk)
         minst_preds_foreach(csm->start, pred_node) {
             pred = pred_node->minst;
 
-            bitset_clone(&defs, &blk->defs[blk->csm.trace_reg]);
-            bitset_and(&defs, &pred->rd_in);
-            if (bitset_count(&defs) > 1) {
+            minst_get_reaching_defs(blk, pred, blk->csm.trace_reg, defs);
+            if (bitset_count(defs) > 1) {
                 while (minst_preds_count(pred) == 1) {
                     pred = pred->preds.minst;
                     if (pred->type == mtype_bcond) break;
@@ -2965,11 +3751,10 @@ int minst_csm_expand2(struct arm_emu *emu, struct minst_blk *blk)
                     continue;
 
                 minst_preds_foreach(pred, pred_node2) {
-                    bitset_clear(&defs2);
-                    bitset_clone(&defs2, &blk->defs[blk->csm.trace_reg]);
-                    bitset_and(&defs2, &pred_node2->minst->rd_in);
+                    bitset_clear(defs2);
+                    minst_get_reaching_defs(blk, pred_node2->minst, blk->csm.trace_reg, defs2);
 
-                    if (bitset_count(&defs2) > 1) break;
+                    if (bitset_count(defs2) > 1) break;
                 }
 
                 if (pred_node2) {
@@ -2982,6 +3767,9 @@ int minst_csm_expand2(struct arm_emu *emu, struct minst_blk *blk)
         }
     }
 
+    minst_blk_scratch_put(blk, defs2);
+    minst_blk_scratch_put(blk, defs);
+
     return 0;
 }
 
@@ -2990,22 +3778,21 @@ int minst_csm_expand(struct arm_emu *emu, struct minst_blk *blk)
     struct minst_node *succ_node;
     struct minst *m, *succ, *t, *cmp;
     struct minst_cfg *csm_cfg, *cfg, *root_cfg = NULL, *parent_cfg;
-    BITSET_INIT(defs);
-    char bincode[16];
-    int i, j, binlen, inst_start, is_end, last_def, changed = 0;
+    struct bitset *defs;
+    int i, j, inst_start, is_end, last_def, changed = 0;
     struct dynarray d = { 0 };
 
     minst_dob_analyze(blk);
 
     csm_cfg = blk->csm.cfg;
 
-    bitset_clone(&defs, &blk->defs[blk->csm.trace_reg]);
-    bitset_and(&defs, &blk->csm.cfg->start->rd_in);
+    defs = minst_blk_scratch_get(blk);
+    minst_get_reaching_defs(blk, blk->csm.cfg->start, blk->csm.trace_reg, defs);
 
     printf("csm[%d] base_reg[r%d] st_reg[r%d] save_reg[%d]\n", 
         blk->csm.cfg->id, blk->csm.base_reg, blk->csm.st_reg, blk->csm.save_reg);
     inst_start = blk->allinst.len;
-    bitset_foreach(&defs, i) {
+    bitset_foreach(defs, i) {
         m = blk->allinst.ptab[i];
         if (m->flag.is_const) {
             if (m->ld_imm > 0)
@@ -3026,7 +3813,7 @@ expand_label:
 
                 minst_succs_foreach(m->cfg->end, succ_node) {
                     succ = succ_node->minst;
-                    if (!bitset_get(&succ->in, def)) continue;
+                    if (!live_regs_get(&succ->in, def)) continue;
 
                     /* FIXME: */
                     cmp = minst_get_last_def(blk, m->cfg->end, ARM_REG_APSR);
@@ -3045,23 +3832,15 @@ expand_label:
                         // root 
                         {
                             cfg = minst_cfg_new(&emu->mblk, NULL, NULL);
-                            if (j == 0) {
-                                arm_asm2bin(bincode, &binlen, "mov r%d, r%d", last_def, def);
-                                minst_new_t(cfg, mtype_ldr, arm_insteng_parse(bincode, binlen, NULL), bincode, binlen);
-                            }
-
-                            arm_asm2bin(bincode, &binlen, "movw r%d, 0x%x", def, t->ld_imm & 0xffff);
-                            minst_new_t(cfg, mtype_cmp, arm_insteng_parse(bincode, binlen, NULL),  bincode, binlen);
+                            if (j == 0)
+                                arm_minst_new_mov(cfg, mtype_ldr, last_def, def);
 
-                            arm_asm2bin(bincode, &binlen, "movt r%d, 0x%x", def, (t->ld_imm >> 16) & 0xffff);
-                            minst_new_t(cfg, mtype_cmp, arm_insteng_parse(bincode, binlen, NULL),  bincode, binlen);
+                            arm_minst_new_movw(cfg, mtype_cmp, def, t->ld_imm & 0xffff);
+                            arm_minst_new_movt(cfg, mtype_cmp, def, (t->ld_imm >> 16) & 0xffff);
 
                             if (!is_end) {
-                                arm_asm2bin(bincode, &binlen, "cmp r%d, r%d", last_def , def);
-                                minst_new_t(cfg, mtype_cmp, arm_insteng_parse(bincode, binlen, NULL),  bincode, binlen);
-
-                                arm_asm2bin(bincode, &binlen, "beq");
-                                minst_new_t(cfg, 0, arm_insteng_parse(bincode, binlen, NULL),  bincode, binlen);
+                                arm_minst_new_cmp(cfg, mtype_cmp, last_def, def);
+                                arm_minst_new_bcond(cfg, 0, ARM_COND_EQ);
                             }
                         }
 
@@ -3094,6 +3873,7 @@ expand_label:
             //vm_error("Not support csm assign minst[%d]", m->id);
         }
     }
+    minst_blk_scratch_put(blk, defs);
 
     EMU_SET_CONST_MODE(emu);
     for (i = inst_start; i < blk->allinst.len; i++) {
@@ -3119,8 +3899,7 @@ int         arm_emu_reduce_csm(struct arm_emu *emu)
     struct minst_blk *blk = &emu->mblk;
     struct minst_cfg *csm_cfg = NULL, *cfg;
     int i, j, k, trace_times, changed;
-    BITSET_INIT(defs);
-    BITSET_INIT(defs1);
+    struct bitset *defs, *defs1;
 
     minst_dob_analyze(blk);
     csm_cfg = blk->csm.cfg;
@@ -3132,6 +3911,8 @@ int         arm_emu_reduce_csm(struct arm_emu *emu)
     trace_times = 1;
     changed = 1;
 
+    defs = minst_blk_scratch_get(blk);
+    defs1 = minst_blk_scratch_get(blk);
     while (changed) {
         changed = 0;
 
@@ -3151,9 +3932,8 @@ int         arm_emu_reduce_csm(struct arm_emu *emu)
             if (!lm_minst)
                 continue;
 
-            bitset_clone(&defs, &blk->defs[cmp->cmp.ln]);
-            bitset_and(&defs, &cmp->rd_in);
-            bitset_foreach(&defs, j) {
+            minst_get_reaching_defs(blk, cmp, cmp->cmp.ln, defs);
+            bitset_foreach(defs, j) {
                 struct minst *t = blk->allinst.ptab[j];
 
                 if (t->flag.is_const) {
@@ -3166,10 +3946,9 @@ int         arm_emu_reduce_csm(struct arm_emu *emu)
 
                 if (t->type == mtype_mov_reg) {
                     int use = minst_get_use(t);
-                    bitset_clone(&defs1, &blk->defs[use]);
-                    bitset_and(&defs1, &t->rd_in);
+                    minst_get_reaching_defs(blk, t, use, defs1);
 
-                    bitset_foreach(&defs1, k) {
+                    bitset_foreach(defs1, k) {
                         if (arm_emu_trace_csm(emu, blk->allinst.ptab[k], trace_times, 0))
                             continue;
 
@@ -3201,14 +3980,17 @@ int         arm_emu_reduce_csm(struct arm_emu *emu)
         }
     }
 
+    minst_blk_scratch_put(blk, defs1);
+    minst_blk_scratch_put(blk, defs);
+
     return 0;
 }
 
 /* FIXME: 后面需要改成半符号执行的方式来应对各种情况 */
-static int arm_emu_bcond_symbo_exec(struct arm_emu *emu, struct minst_cfg *cfg, struct minst *def)
+static int arm_emu_bcond_symbo_exec(struct arm_emu *emu, struct minst *end, int cond, struct minst *def)
 {
-    struct minst_blk *blk = cfg->blk;
-    struct minst *end = cfg->end, *pred;
+    struct minst_blk *blk = &emu->mblk;
+    struct minst *pred;
     struct arm_cpsr apsr = { 0 };
 
     for (pred = end->preds.minst; pred; pred = pred->preds.minst) {
@@ -3233,17 +4015,105 @@ static int arm_emu_bcond_symbo_exec(struct arm_emu *emu, struct minst_cfg *cfg,
     else
         minst_cmp_calc(apsr, def->ld_imm, lm_minst->ld_imm);
 
-    return _ConditionPassed(&apsr, cfg->end->flag.b_cond);
+    return _ConditionPassed(&apsr, cond);
+}
+
+/* 给值编号用，只认 use/def 记录完整的几类 mov/add/sub。16位的数据处理指令在IT块外面会改标志位，
+有的 handler 没有把 APSR 记成 def，所以16位的只放过不改标志位的那几种 */
+static int  arm_emu_minst_pure(struct minst *minst)
+{
+    struct reg_node *reg_node = minst->reg_node;
+    uint16_t code;
+
+    if (!reg_node || !minst->flag.decoded)
+        return 0;
+
+    if ((reg_node->func != thumb_inst_mov) && (reg_node->func != t1_inst_mov_w)
+        && (reg_node->func != t1_inst_mov_0100)
+        && (reg_node->func != t1_inst_add) && (reg_node->func != thumb_inst_add)
+        && (reg_node->func != thumb_inst_sub) && (reg_node->func != thumb_inst_sub_reg))
+        return 0;
+
+    if ((minst->len == 4) || minst->flag.in_it_block)
+        return 1;
+
+    code = *(uint16_t *)minst->addr;
+    /* add ld, sp, #imm; add/sub sp, #imm; add ld, lm; mov ld, lm */
+    return ((code & 0xf000) == 0xa000) || ((code & 0xff00) == 0xb000)
+        || ((code & 0xff00) == 0x4400) || ((code & 0xff00) == 0x4600);
+}
+
+/* 给 minst_conditional_const_propagation 用，算条件跳转(或者IT)的条件，只回答不改IR */
+static int  arm_emu_minst_cond(void *_emu, struct minst *minst)
+{
+    struct arm_emu *emu = _emu;
+    struct minst_blk *blk = &emu->mblk;
+    struct minst *cminst, *def_minst;
+    struct dynarray defs = {0};
+    int i, n, cond, use_reg, ret, pret;
+
+    /* 之前已经定下来的 */
+    if (minst->flag.is_const)
+        return minst->flag.b_cond_passed;
+
+    if (!minst->flag.decoded)
+        return -1;
+    cond = minst->ctx.cond;
+
+    cminst = minst_get_last_const_definition(blk, minst, ARM_REG_APSR);
+    if (cminst && cminst->flag.is_const)
+        return _ConditionPassed(&cminst->apsr, cond);
+
+    /* 
+    FIXME:注释写的不对
+    假如比较的2个寄存器不是直接常量，
+    比如 cmp r5, r0 
+    我们分开确认每个寄存器比如 r5，是由哪个值定义的，他的上方是否有形如
+        mov r5, r6
+    这样的指令，如果是的话，因为r6一定不是常量(假如是常量，那么在常量传播中
+    r6和r5一定已经被常数化了)，所以我们尝试分析r6为什么不是常量，有2种可能
+    1. 本身的值就是模糊定义的，可能是外部参数进来的，可能是某函数返回值，或者内存里的某个定义
+    2. 这条指令所在的cfg节点有多个前驱节点，每个前驱节点都有对r6的定值
+
+    我们先不分析1的情况，2中的情况，假如2中的每个前驱节点对r6的定值，对 状态寄存器 的影响
+    是一样的，那么我们认为这个地方的cmp指令是可以优化的。
+
+    我们把这种优化称之胃 多路径常量优化
+
+    先不处理2个指令都要做多路径常量优化的情况
+    */
+    if (!minst->cfg || (minst->cfg->end != minst))
+        return -1;
+
+    cminst = minst_cfg_apsr_get_overdefine_reg(minst->cfg, &use_reg);
+    if (!cminst) return -1;
+
+    /* 常量传播过程中，还没算出来的定值不在 defs 里，一个都没有就等它们算出来再看 */
+    n = minst_get_const_defs(blk, cminst, use_reg, &defs);
+    if (n <= 0) {
+        dynarray_reset(&defs);
+        return n ? -1 : -2;
+    }
+
+    pret = ret = -1;
+    for (i = 0; i < n; i++) {
+        def_minst = defs.ptab[i];
+
+        ret = arm_emu_bcond_symbo_exec(emu, minst, cond, def_minst);
+        if (ret == -1) break;
+        if (pret == -1) pret = ret;
+        else if (pret != ret) break;
+    }
+    dynarray_reset(&defs);
+
+    return (i < n) ? -1 : ret;
 }
 
 int         minst_blk_const_propagation(struct arm_emu *emu, int delcode)
 {
-    struct bitset *uses;
-    struct minst *minst, *use_minst, *def_minst;
+    struct minst *minst;
     struct minst_blk *blk = &emu->mblk;
-    struct minst_cfg *cfg;
-    BITSET_INIT(defs);
-    int i, changed = 1, pos, use_reg, ret, pret;
+    int i;
 
     EMU_SET_CONST_MODE(emu);
 
@@ -3253,115 +4123,334 @@ int         minst_blk_const_propagation(struct arm_emu *emu, int delcode)
             dynarray_add(&blk->const_insts, minst);
     }
 
-    /* MCIC P446 */
-    while (changed) {
-        changed = 0;
+    /* MCIC P446 
+    常量折叠、常量条件和不可达的边都在 minst_conditional_const_propagation 里一遍做完，
+    之后删一次不可达的cfg和死代码就行，不用再回头重跑 */
+    minst_blk_liveness_calc(&emu->mblk);
+    minst_blk_ssa_update(&emu->mblk);
 
-        minst_blk_liveness_calc(&emu->mblk);
-        minst_blk_gen_reaching_definitions(&emu->mblk);
-
-        if (delcode) {
-            changed |= minst_blk_copy_propagation(&emu->mblk);
-        }
-
-        /* constant folding */
-        for (i = 0; i < blk->const_insts.len; i++) {
-            minst = blk->const_insts.ptab[i];
-            if (minst->flag.dead_code) continue;
-            if (minst_get_def(minst) < 0) continue;
-
-            /* 遍历所有使用minst定值的 use 列表*/
-            uses = &blk->uses[minst_get_def(minst)];
-            for (pos = bitset_next_bit_pos(uses, 0); pos > 0; pos = bitset_next_bit_pos(uses, pos + 1)) {
-                use_minst = blk->allinst.ptab[pos];
-                if (use_minst->flag.dead_code) continue;
-                if (use_minst->flag.is_const) continue;
-
-                /* 
-                1. 查看使用列表中的指令的 reaching definitions in 集合中是否有这条指令，
-                假如有的话，确认in集合中的def指令时唯一一条对 minst_get_def(minst) 中进行
-                定值的指令.
-                2. 假如多个定值都一样时
-                 */
-                if (minst_get_last_const_definition(blk, use_minst, minst_get_def(minst))) {
-                    arm_minst_do(emu, use_minst);
-
-                    if (use_minst->flag.is_const) {
-                        dynarray_add(&blk->const_insts, use_minst);
-                        changed = 1;
-                    }
-                }
-            }
-        }
+    /* 值编号和复写传播在前面做一次，把经过寄存器、栈中转的值接到原来的定值上，不做的话
+    常量传播找到的常量少，最后留下的指令明显变多 */
+    if (delcode) {
+        minst_blk_value_numbering(&emu->mblk);
+        minst_blk_copy_propagation(&emu->mblk);
+    }
 
-        /* 
-        FIXME:注释写的不对
-        假如比较的2个寄存器不是直接常量，
-        比如 cmp r5, r0 
-        我们分开确认每个寄存器比如 r5，是由哪个值定义的，他的上方是否有形如
-            mov r5, r6
-        这样的指令，如果是的话，因为r6一定不是常量(假如是常量，那么在常量传播中
-        r6和r5一定已经被常数化了)，所以我们尝试分析r6为什么不是常量，有2种可能
-        1. 本身的值就是模糊定义的，可能是外部参数进来的，可能是某函数返回值，或者内存里的某个定义
-        2. 这条指令所在的cfg节点有多个前驱节点，每个前驱节点都有对r6的定值
+    minst_conditional_const_propagation(blk);
 
-        我们先不分析1的情况，2中的情况，假如2中的每个前驱节点对r6的定值，对 状态寄存器 的影响
-        是一样的，那么我们认为这个地方的cmp指令是可以优化的。
+    /* delete unreachable code 
+    除了起始cfg节点，其余前驱节点为0的cfg都是不可达的
+    */
+    minst_blk_del_unreachable(blk);
 
-        我们把这种优化称之胃 多路径常量优化
+    if (delcode)
+        minst_blk_dead_code_elim(blk);
 
-        先不处理2个指令都要做多路径常量优化的情况
-        */
-        /* constant conditions */
-        for (i = 0; i < blk->allcfg.len; i++) {
-            cfg = blk->allcfg.ptab[i];
+    /* 删边、删cfg、死代码删除最后删掉的跳转块都还没有更新过活跃性 */
+    minst_blk_liveness_update(blk);
 
-            if (cfg->flag.dead_code) continue;
-            if (minst_succs_count(cfg->end) <= 1) continue;
+    return 0;
+}
+
+/* 指令编码器，直接生成thumb指令的二进制编码，返回编码的字节数 */
+static int arm_enc_put(uint8_t *bin, uint16_t t1, uint16_t t2, int len)
+{
+    memcpy(bin, &t1, 2);
+    if (len == 4)
+        memcpy(bin + 2, &t2, 2);
+
+    return len;
+}
 
-            minst = minst_cfg_apsr_get_overdefine_reg(cfg, &use_reg);
-            if (!minst) continue;
+/* MOV (register) T1 */
+static int arm_enc_mov(uint8_t *bin, int rd, int rm)
+{
+    uint16_t t1 = 0b0100011000000000;
 
-            bitset_clone(&defs, &blk->defs[use_reg]);
-            bitset_and(&defs, &minst->rd_in);
-            pret = ret = -1;
-            bitset_foreach(&defs, pos) {
-                def_minst = blk->allinst.ptab[pos];
-                if (!def_minst->flag.is_const) break;
+    t1 |= rd & 0x7;
+    t1 |= (rd & 0x8) << 4;
+    t1 |= rm << 3;
 
-                ret = arm_emu_bcond_symbo_exec(emu, cfg, def_minst);
-                if (ret == -1) break;
-                if (pret == -1) pret = ret;
-                else if (pret != ret) break;
-            }
+    return arm_enc_put(bin, t1, 0, 2);
+}
 
-            if (pos < 0) {
-                cfg->end->flag.is_const = 1;
-                cfg->end->flag.b_cond_passed = ret;
-                arm_minst_do(emu, cfg->end);
-                printf("delete cfg [%d:%d-%d]\n", cfg->id, cfg->start->id, cfg->end->id);
-                changed = 1;
-            }
+/* P484 */
+static int arm_enc_movw(uint8_t *bin, int rd, int imm)
+{
+    uint16_t t1 = 0b1111001001000000, t2 = 0;
+
+    t1 |= BITS_GET_SHL(imm, 11, 1, 10);
+    t1 |= BITS_GET_SHL(imm, 12, 4, 0);
+    t2 |= BITS_GET_SHL(imm, 8, 3, 12);
+    t2 |= rd << 8;
+    t2 |= BITS_GET_SHL(imm, 0, 8, 0);
+
+    return arm_enc_put(bin, t1, t2, 4);
+}
+
+/* P491 */
+static int arm_enc_movt(uint8_t *bin, int rd, int imm)
+{
+    uint16_t t1 = 0b1111001011000000, t2 = 0;
+
+    t1 |= BITS_GET_SHL(imm, 11, 1, 10);
+    t1 |= BITS_GET_SHL(imm, 12, 4, 0);
+    t2 |= rd << 8;
+    t2 |= BITS_GET_SHL(imm, 8, 3, 12);
+    t2 |= BITS_GET_SHL(imm, 0, 8, 0);
+
+    return arm_enc_put(bin, t1, t2, 4);
+}
+
+/* @AAR.P372 */
+static int arm_enc_cmp(uint8_t *bin, int rn, int rm)
+{
+    uint16_t t1;
+
+    if ((rn < 8) && (rm < 8)) {
+        t1 = 0b0100001010000000;
+        t1 |= rm << 3;
+        t1 |= rn;
+    }
+    else {
+        t1 = 0b0100010100000000;
+        t1 |= rm << 3;
+        t1 |= rn & 7;
+        t1 |= (rn >> 3) << 7;
+    }
+
+    return arm_enc_put(bin, t1, 0, 2);
+}
+
+/* @AAR.P334，跳转偏移都填0，真正的目标由cfg的边决定 */
+static int arm_enc_b(uint8_t *bin)
+{
+    return arm_enc_put(bin, 0xe000, 0, 2);
+}
+
+static int arm_enc_bcond(uint8_t *bin, int cond)
+{
+    return arm_enc_put(bin, 0xd000 | (cond << 8), 0, 2);
+}
+
+/* 编码直接写在 minst_blk 的 text_sec 里，写完以后查表拿到 reg_node */
+#define arm_minst_enc_done(m, enc)  ((m)->reg_node = arm_insteng_parse((m)->addr, enc, NULL), (m))
+
+static struct minst*        arm_minst_new_mov(struct minst_cfg *cfg, enum minst_type type, int rd, int rm)
+{
+    struct minst *m = minst_new_t(cfg, type, NULL, NULL, 2);
+    return arm_minst_enc_done(m, arm_enc_mov(m->addr, rd, rm));
+}
+
+static struct minst*        arm_minst_new_movw(struct minst_cfg *cfg, enum minst_type type, int rd, int imm16)
+{
+    struct minst *m = minst_new_t(cfg, type, NULL, NULL, 4);
+    return arm_minst_enc_done(m, arm_enc_movw(m->addr, rd, imm16));
+}
+
+static struct minst*        arm_minst_new_movt(struct minst_cfg *cfg, enum minst_type type, int rd, int imm16)
+{
+    struct minst *m = minst_new_t(cfg, type, NULL, NULL, 4);
+    return arm_minst_enc_done(m, arm_enc_movt(m->addr, rd, imm16));
+}
+
+static struct minst*        arm_minst_new_cmp(struct minst_cfg *cfg, enum minst_type type, int rn, int rm)
+{
+    struct minst *m = minst_new_t(cfg, type, NULL, NULL, 2);
+    return arm_minst_enc_done(m, arm_enc_cmp(m->addr, rn, rm));
+}
+
+static struct minst*        arm_minst_new_b(struct minst_cfg *cfg, enum minst_type type)
+{
+    struct minst *m = minst_new_t(cfg, type, NULL, NULL, 2);
+    return arm_minst_enc_done(m, arm_enc_b(m->addr));
+}
+
+static struct minst*        arm_minst_new_bcond(struct minst_cfg *cfg, enum minst_type type, int cond)
+{
+    struct minst *m = minst_new_t(cfg, type, NULL, NULL, 2);
+    return arm_minst_enc_done(m, arm_enc_bcond(m->addr, cond));
+}
+
+static struct minst*        arm_minst_change_b(struct minst *minst)
+{
+    struct minst *m = minst_change(minst, mtype_b, NULL, NULL, 2);
+    return arm_minst_enc_done(m, arm_enc_b(m->addr));
+}
+
+/* 指令里的一个寄存器字段：在第 hw 个半字的 lo 位开始，宽 bits 位，hi >= 0 时第 hi 位是
+寄存器号的最高位(D:Rd 这种拆开的写法) */
+struct arm_reg_field {
+    int hw;
+    int lo;
+    int bits;
+    int hi;
+};
+
+/* 认识的几种编码里寄存器字段的位置，字段全是寄存器(值是15的不算)，不认识的返回0 */
+static int arm_reg_fields(uint16_t *c, int len, struct arm_reg_field *f)
+{
+    int op, n = 0;
+
+#define FIELD(_hw, _lo, _bits, _hi)     (f[n].hw = _hw, f[n].lo = _lo, f[n].bits = _bits, f[n].hi = _hi, n++)
+    if (len == 2) {
+        /* add/sub (register) T1 */
+        if (((c[0] & 0xfc00) == 0x1800))
+            FIELD(0, 0, 3, -1), FIELD(0, 3, 3, -1), FIELD(0, 6, 3, -1);
+        /* add/sub (immediate) T1 */
+        else if ((c[0] & 0xfc00) == 0x1c00)
+            FIELD(0, 0, 3, -1), FIELD(0, 3, 3, -1);
+        /* mov/cmp (immediate) T1 */
+        else if (((c[0] & 0xf800) == 0x2000) || ((c[0] & 0xf800) == 0x2800))
+            FIELD(0, 8, 3, -1);
+        /* cmp (register) T1 */
+        else if ((c[0] & 0xffc0) == 0x4280)
+            FIELD(0, 0, 3, -1), FIELD(0, 3, 3, -1);
+        /* add/cmp/mov (register) T2 */
+        else if (((c[0] & 0xff00) == 0x4400) || ((c[0] & 0xff00) == 0x4500) || ((c[0] & 0xff00) == 0x4600))
+            FIELD(0, 0, 3, 7), FIELD(0, 3, 4, -1);
+    }
+    else if (len == 4) {
+        /* data processing (modified immediate) */
+        if (((c[0] & 0xfa00) == 0xf000) && !(c[1] & 0x8000))
+            FIELD(0, 0, 4, -1), FIELD(1, 8, 4, -1);
+        /* data processing (shifted register) */
+        else if ((c[0] & 0xfe00) == 0xea00)
+            FIELD(0, 0, 4, -1), FIELD(1, 8, 4, -1), FIELD(1, 0, 4, -1);
+        /* data processing (plain binary immediate)，只认 addw/subw/movw/movt */
+        else if (((c[0] & 0xfa00) == 0xf200) && !(c[1] & 0x8000)) {
+            op = (c[0] >> 4) & 0x1f;
+            if ((op == 0b00000) || (op == 0b01010))
+                FIELD(0, 0, 4, -1), FIELD(1, 8, 4, -1);
+            else if ((op == 0b00100) || (op == 0b01100))
+                FIELD(1, 8, 4, -1);
         }
+    }
+#undef FIELD
+
+    return n;
+}
+
+static int arm_reg_field_get(uint16_t *c, struct arm_reg_field *f)
+{
+    int v = (c[f->hw] >> f->lo) & ((1 << f->bits) - 1);
+
+    if (f->hi >= 0)
+        v |= ((c[f->hw] >> f->hi) & 1) << f->bits;
+
+    return v;
+}
+
+static void arm_reg_field_set(uint16_t *c, struct arm_reg_field *f, int v)
+{
+    c[f->hw] &= ~(((1 << f->bits) - 1) << f->lo);
+    c[f->hw] |= (v & ((1 << f->bits) - 1)) << f->lo;
+
+    if (f->hi >= 0) {
+        c[f->hw] &= ~(1 << f->hi);
+        c[f->hw] |= ((v >> f->bits) & 1) << f->hi;
+    }
+}
+
+/* 取出指令的编码和寄存器字段。字段里的寄存器要和活跃信息里记的 use/def 完全一样才认，
+不然说明 handler 的活跃信息不全，按字段改寄存器或者比较会出错，返回0 */
+static int  arm_minst_reg_fields(struct minst *minst, uint16_t *c, struct arm_reg_field *f)
+{
+    int i, n, v, regs = 0, live = 0;
+
+    if (minst->flag.prologue || minst->flag.epilogue || !minst->cfg || ((minst->len != 2) && (minst->len != 4)))
+        return 0;
+
+    memcpy(c, minst->addr, minst->len);
+    if (!(n = arm_reg_fields(c, minst->len, f)))
+        return 0;
 
+    for (i = 0; i < n; i++) {
+        v = arm_reg_field_get(c, &f[i]);
+        if (v != ARM_REG_PC)
+            regs |= 1 << v;
+    }
+
+    for (i = 0; i < ARM_REG_PC; i++) {
+        if (live_regs_get(&minst->use, i) || live_regs_get(&minst->def, i))
+            live |= 1 << i;
+    }
+
+    return (regs == live) ? n : 0;
+}
+
+/* 给值编号用 */
+static int  arm_emu_minst_fields(struct minst *minst, unsigned char *code, int *regs)
+{
+    struct arm_reg_field f[MINST_FIELDS_MAX];
+    uint16_t c[2];
+    int i, n;
 
-        /* delete unreachable code 
-        除了起始cfg节点，其余前驱节点为0的cfg都是不可达的
-        */
-        changed |= minst_blk_del_unreachable(blk);
+    if (!(n = arm_minst_reg_fields(minst, c, f)))
+        return 0;
 
-        if (delcode)
-            changed |= minst_blk_dead_code_elim(blk);
+    for (i = 0; i < n; i++) {
+        regs[i] = arm_reg_field_get(c, &f[i]);
+        if (regs[i] == ARM_REG_PC)
+            regs[i] = -1;
     }
 
+    for (i = 0; i < n; i++) {
+        if (regs[i] >= 0)
+            arm_reg_field_set(c, &f[i], 0);
+    }
+    memcpy(code, c, minst->len);
+
+    return n;
+}
+
+/* 给 mov 合并用 */
+static int  arm_emu_minst_rename(struct minst *minst, int *map)
+{
+    struct arm_reg_field f[MINST_FIELDS_MAX];
+    uint16_t c[2];
+    int i, n, v, mask = 0x1fff;
+
+    if (!(n = arm_minst_reg_fields(minst, c, f)))
+        return map ? -1 : 0;
+
+    for (i = 0; i < n; i++) {
+        if ((f[i].bits == 3) && (f[i].hi < 0))
+            mask = 0xff;
+    }
+
+    if (!map)
+        return mask;
+
+    for (i = 0; i < n; i++) {
+        v = arm_reg_field_get(c, &f[i]);
+        if ((v == ARM_REG_PC) || (map[v] == v)) continue;
+        if (!((mask >> map[v]) & 1))
+            return -1;
+
+        arm_reg_field_set(c, &f[i], map[v]);
+    }
+
+    /* cmp T2 不能两个都是低寄存器，换成 T1 */
+    if (((c[0] & 0xff00) == 0x4500) && (arm_reg_field_get(c, &f[0]) < 8) && (arm_reg_field_get(c, &f[1]) < 8))
+        c[0] = 0x4280 | (c[0] & 0x3f);
+
+    if (minst->type == mtype_cmp) {
+        if ((minst->cmp.lm >= 0) && (minst->cmp.lm < ARM_REG_PC)) minst->cmp.lm = map[minst->cmp.lm];
+        if ((minst->cmp.ln >= 0) && (minst->cmp.ln < ARM_REG_PC)) minst->cmp.ln = map[minst->cmp.ln];
+    }
+
+    minst_change(minst, minst->type, NULL, (unsigned char *)c, minst->len);
+    minst->reg_node = arm_insteng_parse(minst->addr, minst->len, NULL);
+
     return 0;
 }
 
 char *arm_asm2bin(char *bin, int *olen, const char *asm, ...)
 {
     char buf[128], *pos;
-    short t1, t2;
-    int i, len, rd, imm, rm, rn;
+    uint8_t *code = (uint8_t *)bin;
+    int i, len = 0, rd, imm, rm, rn;
 
     va_list ap;
     va_start(ap, asm);
@@ -3374,75 +4463,31 @@ char *arm_asm2bin(char *bin, int *olen, const char *asm, ...)
 
     switch (buf[0]) {
     case 'b':
-        /* @AAR.P334 */
-        t1 = 0xe000;
-        if (buf[1] == 'e') {
-            t1 = 0xd000;
-        }
-        len = 2;
+        len = (buf[1] == 'e') ? arm_enc_bcond(code, ARM_COND_EQ) : arm_enc_b(code);
         break;
 
     case 'c':
-        /* @AAR.P372*/
         sscanf(buf, "cmp r%d, r%d", &rn, &rm);
-        if ((rn < 8) && (rm < 8)) {
-            t1 = 0b0100001010000000;
-            t1 |= rm << 3;
-            t1 |= rn;
-        }
-        else {
-            t1 = 0b0100010100000000;
-            t1 |= rm << 3;
-            t1 |= rn & 7;
-            t1 |= (rn >> 3) << 7;
-        }
-        len = 2;
+        len = arm_enc_cmp(code, rn, rm);
         break;
 
     case 'm':
         if ((pos = strstr(buf, "0x"))) {
             rd = atoi(strchr(buf, 'r') + 1);
             imm = strtol(pos + 2, NULL, 16);
-            if (buf[3] == 't') {
-                /* P491 */
-                t1 = 0b1111001011000000;
-                t2 = 0b0000000000000000;
-                t1 |= BITS_GET_SHL(imm, 11, 1, 10);
-                t1 |= BITS_GET_SHL(imm, 12, 4, 0);
-                t2 |= rd << 8;
-                t2 |= BITS_GET_SHL(imm, 8, 3, 12);
-                t2 |= BITS_GET_SHL(imm, 0, 8, 0);
-            }
-            else {
-                /* P484 */
-                t1 = 0b1111001001000000;
-                t2 = 0b0000000000000000;
-                t1 |= ((imm >> 11) & 1) << 10;
-                t1 |= (imm >> 12) & 0xf;
-                t2 |= ((imm >> 8) & 7) << 12;
-                t2 |= rd << 8;
-                t2 |= imm & 0xff;
-            }
-            len = 4;
+            len = (buf[3] == 't') ? arm_enc_movt(code, rd, imm) : arm_enc_movw(code, rd, imm);
         }
         else {
             sscanf(buf, "mov r%d, r%d", &rd, &rm);
-            t1 = 0b0100011000000000;
-            t1 |= rd & 0x7;
-            t1 |= (rd & 0x8) << 7;
-            t1 |= rm << 3;
-            len = 2;
+            len = arm_enc_mov(code, rd, rm);
         }
         break;
 
     default:
+        len = 0;
         break;
     }
 
-    memcpy(bin, &t1, 2);
-    if (len == 4)
-        memcpy(bin + 2,  &t2, 2);
-
     if (olen)
         *olen = len;
 
@@ -3459,6 +4504,7 @@ int         arm_emu_run(struct arm_emu *emu)
     arm_emu_cpu_reset(emu);
     EMU_SET_SEQ_MODE(emu);
     minst_blk_live_prologue_add(&emu->mblk, PROCESS_STACK_BASE);
+    arm_predecode(emu, emu->code.data, emu->code.len);
     for (emu->code.pos = 0; emu->code.pos < emu->code.len; ) {
         ret = arm_insteng_decode(emu, emu->code.data + emu->code.pos, emu->code.len - emu->code.pos);
         if (ret < 0) {
@@ -3475,15 +4521,19 @@ int         arm_emu_run(struct arm_emu *emu)
     /* third pass */
     minst_blk_liveness_calc(&emu->mblk);
 
-    minst_blk_gen_reaching_definitions(&emu->mblk);
+    minst_blk_ssa_update(&emu->mblk);
 
     minst_blk_const_propagation(emu, 1);
 
+    minst_blk_out_of_order(&emu->mblk);
+
     arm_emu_dump_cfg(emu, "new");
     arm_emu_dump_mblk(emu, "orig");
 
     arm_emu_reduce_csm(emu);
 
+    minst_blk_coalesce(&emu->mblk);
+
     arm_emu_dump_mblk(emu, "finial");
 
     return 0;
@@ -125,6 +125,15 @@ int arm_emu_run(struct arm_emu *vm);
 /* 从指令中获取关键性上下文 */
 int arm_inst_extract_ctx(struct arm_inst_ctx *ctx, const char *exp, uint8_t *code, int code_len);
 
+/* 解码一条thumb指令并提取上下文，不执行，给 bench_decode 这类离线工具用
+@return     >0      指令字节数
+            0       未知编码或者指令被截断
+*/
+int arm_inst_decode(struct arm_inst_ctx *ctx, uint8_t *code, int code_len);
+
+/* 根据 desclist 生成解码表的C代码，构建时由 armgen 调用 */
+int arm_insteng_gen_source(const char *filename);
+
 /*
 arm assembly to binary code
 @olen       bincode len
@@ -0,0 +1,127 @@
+﻿
+#include "mcore/mcore.h"
+#include "vm.h"
+#include "arm_emu.h"
+
+/* bench_decode: 对 data/ 下的so里 .dynsym 中所有的thumb函数做线性解码，统计解码器吞吐。
+解码走的是 arm_emu_run 里用的同一张查找表和字段提取程序，不执行指令 */
+#if defined(ARM_INSTENG_BENCH)
+
+#define BENCH_ROUNDS_DEFAULT        10
+
+static const char *bench_files[] = {
+    "data/libmakeurl2.4.9.so",
+    "data/libcms.so",
+    "data/libSecShell.so",
+    "data/libc.so",
+};
+
+struct bench_stat {
+    int                 funcs;
+    long long           insts;
+    long long           unknown;
+    unsigned long long  ns;
+};
+
+static void bench_decode_file(const char *filename, int rounds, struct bench_stat *st)
+{
+    Elf32_Ehdr *hdr;
+    Elf32_Sym *sym;
+    struct arm_inst_ctx ctx;
+    unsigned char *data, *code;
+    unsigned long long t;
+    int i, r, num, len, pos, ret;
+
+    data = (unsigned char *)file_load(filename, &len);
+    if (!data)
+        vm_error("bench_decode() failed with load file[%s]", filename);
+
+    hdr = (Elf32_Ehdr *)data;
+    num = elf32_sym_count(hdr);
+
+    memset(st, 0, sizeof (st[0]));
+    for (r = 0; r < rounds; r++) {
+        t = mtime_ns();
+        for (i = 0; i < num; i++) {
+            sym = elf32_sym_geti(hdr, i);
+
+            /* 只解码thumb函数，偶数地址是arm指令 */
+            if ((ELF32_ST_TYPE(sym->st_info) != STT_FUNC) || (sym->st_shndx == SHN_UNDEF)
+                || !(sym->st_value & 1) || !sym->st_size
+                || ((sym->st_value & ~1) + sym->st_size > (unsigned)len))
+                continue;
+
+            code = data + (sym->st_value & ~1);
+            for (pos = 0; pos < (int)sym->st_size; ) {
+                ret = arm_inst_decode(&ctx, code + pos, sym->st_size - pos);
+                if (!ret) {
+                    /* 函数尾部的常量池会落到这里，按半字跳过 */
+                    if (!r) st->unknown++;
+                    pos += 2;
+                    continue;
+                }
+
+                if (!r) st->insts++;
+                pos += ret;
+            }
+
+            if (!r) st->funcs++;
+        }
+        st->ns += mtime_ns() - t;
+    }
+
+    free(data);
+}
+
+static void bench_print(const char *name, struct bench_stat *st, int rounds)
+{
+    double ns = (double)st->ns / rounds;
+    double insts = (double)(st->insts + st->unknown);
+
+    printf("%-28s funcs %6d  insts %9lld  unknown %8lld  %10.3f ms  %8.2f Minst/s  %7.2f ns/inst\n",
+        name, st->funcs, st->insts, st->unknown, ns / 1e6,
+        ns ? insts * 1e3 / ns : 0, insts ? ns / insts : 0);
+}
+
+int main(int argc, char **argv)
+{
+    struct bench_stat st, total;
+    struct arm_inst_ctx ctx;
+    uint8_t nop[4] = {0};
+    const char **files = bench_files;
+    int i, num = count_of_array(bench_files), rounds = BENCH_ROUNDS_DEFAULT;
+
+    if ((argc > 2) && !strcmp(argv[1], "-n")) {
+        rounds = atoi(argv[2]);
+        argc -= 2;
+        argv += 2;
+    }
+
+    if (rounds <= 0)
+        return fputs("Usage: bench_decode [-n rounds] [files ...]\n", stderr), 1;
+
+    if (argc > 1) {
+        files = (const char **)argv + 1;
+        num = argc - 1;
+    }
+
+    /* 第一次调用会初始化解码表，不计入时间 */
+    arm_inst_decode(&ctx, nop, sizeof (nop));
+
+    memset(&total, 0, sizeof (total));
+    for (i = 0; i < num; i++) {
+        bench_decode_file(files[i], rounds, &st);
+        bench_print(files[i], &st, rounds);
+
+        total.funcs += st.funcs;
+        total.insts += st.insts;
+        total.unknown += st.unknown;
+        total.ns += st.ns;
+    }
+
+    bench_print("total", &total, rounds);
+
+    return 0;
+}
+
+#endif
@@ -27,6 +27,18 @@ static const char version[] =
 #endif
 ")\n";
 
+#if defined(ARM_INSTENG_GEN)
+#include "arm_emu.h"
+
+/* armgen: 构建时生成 arm_insteng_tbl.h */
+int main(int argc, char **argv)
+{
+    if (argc != 2)
+        return fputs("Usage: armgen outfile\n", stderr), 1;
+
+    return arm_insteng_gen_source(argv[1]);
+}
+#elif !defined(ARM_INSTENG_BENCH)
 int main(int argc, char **argv)
 {
     int opt;
@@ -56,4 +68,5 @@ int main(int argc, char **argv)
     dobc_delete(s);
 
     return 0;
-}
\ No newline at end of file
+}
+#endif
@@ -6,6 +6,11 @@
 
 #define TVAR_BASE       32
 
+static void         minst_live_summary(struct minst_df *df, int b, unsigned int *gen, unsigned int *kill);
+static void         minst_rd_summary(struct minst_df *df, int b, unsigned int *gen, unsigned int *kill);
+static void         minst_rd_rows_fit(struct minst_blk *blk, int n);
+static void         minst_du_del(struct minst *m);
+
 static inline int minst_cmp(void *a, void *b, void *ref)
 {
     long l = (unsigned long)a;
@@ -42,6 +47,13 @@ void                minst_blk_init(struct minst_blk *blk, char *funcname, minst_
 
     blk->funcname = strdup(funcname);
 
+    marena_init(&blk->arena, 64 * KB);
+
+    rset_init(&blk->rd.empty);
+    bitmat_init(&blk->rd.defs, 0, 0);
+    minst_df_init(&blk->rd.df, MINST_DF_FORWARD, minst_rd_summary, NULL);
+    minst_df_init(&blk->live_df, MINST_DF_BACKWARD, minst_live_summary, NULL);
+
     blk->allinst.compare_func = minst_cmp;
 
     blk->trace_top = -1;
@@ -57,9 +69,6 @@ void                minst_blk_uninit(struct minst_blk *blk)
 
     if (blk->funcname)  free(blk->funcname);
 
-    for (i = 0; i < blk->tvar.len; i++) {
-        free(blk->tvar.ptab[i]);
-    }
     dynarray_reset(&blk->tvar);
 
     for (i = 0; i < blk->allinst.len; i++) {
@@ -72,23 +81,67 @@ void                minst_blk_uninit(struct minst_blk *blk)
     }
     dynarray_reset(&blk->allcfg);
 
+    minst_rd_rows_fit(blk, 0);
+    bitmat_uninit(&blk->rd.defs);
+    minst_df_uninit(&blk->rd.df);
+    minst_df_uninit(&blk->live_df);
+    if (blk->rd.def)        free(blk->rd.def);
+    if (blk->rd.expanded)   free(blk->rd.expanded);
+    minst_blk_ssa_uninit(blk);
+    minst_blk_dom_uninit(blk);
+    minst_blk_du_uninit(blk);
+
+    for (i = 0; i < blk->scratch.num; i++)
+        bitset_uninit(blk->scratch.sets[i]);
+    if (blk->scratch.sets)  free(blk->scratch.sets);
+
+    marena_uninit(&blk->arena);
+
+    for (i = 0; i < blk->text_sec.chunks.len; i++) {
+        free(blk->text_sec.chunks.ptab[i]);
+    }
+    dynarray_reset(&blk->text_sec.chunks);
+
     memset(blk, 0, sizeof (blk[0]));
 }
 
+#define MINST_TEXT_CHUNK_SIZE       (8 * KB)
+
+unsigned char*      minst_blk_text_alloc(struct minst_blk *blk, int len)
+{
+    unsigned char *chunk;
+
+    if (!blk->text_sec.chunks.len || (blk->text_sec.len + len > MINST_TEXT_CHUNK_SIZE)) {
+        chunk = calloc(1, MINST_TEXT_CHUNK_SIZE);
+        if (!chunk)
+            vm_error("minst_blk_text_alloc() failed with calloc");
+
+        dynarray_add(&blk->text_sec.chunks, chunk);
+        blk->text_sec.len = 0;
+    }
+
+    chunk = blk->text_sec.chunks.ptab[blk->text_sec.chunks.len - 1];
+    blk->text_sec.len += len;
+
+    return chunk + blk->text_sec.len - len;
+}
+
 void                minst_blk_add_funcend(struct minst_blk *blk, struct minst *m)
 {
     m->flag.funcend = 1;
     bitset_set(&blk->funcends, m->id, 1);
+    minst_blk_dom_invalidate(blk);
 }
 
 struct minst*       minst_new(struct minst_blk *blk, unsigned char *code, int len, void *reg_node)
 {
     struct minst *minst;
 
-    minst = calloc(1, sizeof (minst[0]));
+    minst = marena_alloc(&blk->arena, sizeof (minst[0]));
     if (!minst)
         vm_error("minst_new() failure");
 
+    minst->blk = blk;
     minst->addr = code;
     minst->len = len;
     minst->reg_node = reg_node;
@@ -96,38 +149,14 @@ struct minst*       minst_new(struct minst_blk *blk, unsigned char *code, int le
     minst->ld = -2;
 
     dynarray_add(&blk->allinst, minst);
-    bitset_init(&minst->use, 32);
-    bitset_init(&minst->def, 32);
-    bitset_init(&minst->in, 32);
-    bitset_init(&minst->out, 32);
+    minst_blk_ssa_invalidate(blk);
 
     return minst;
 }
 
+/* minst本身和边节点都在 blk->arena 里，随blk一起释放 */
 void                minst_delete(struct minst *minst)
 {
-    struct minst_node *node, *next;
-
-    bitset_uninit(&minst->use);
-    bitset_uninit(&minst->def);
-    bitset_uninit(&minst->in);
-    bitset_uninit(&minst->out);
-
-    node = minst->succs.next;
-    while (node) {
-        next = node->next;
-        free(node);
-        node = next;
-    }
-
-    node = minst->preds.next;
-    while (node) {
-        next = node->next;
-        free(node);
-        node = next;
-    }
-
-    free(minst);
 }
 
 struct minst*       minst_new_copy(struct minst_cfg *cfg, struct minst *src)
@@ -135,13 +164,11 @@ struct minst*       minst_new_copy(struct minst_cfg *cfg, struct minst *src)
     struct minst_blk *blk = cfg->blk;
     struct minst *dst = minst_new(blk, NULL, 0, NULL);
 
-    dst->addr = blk->text_sec.data + blk->text_sec.len;
-    blk->text_sec.len += src->len;
-
+    dst->addr = minst_blk_text_alloc(blk, src->len);
     dst->len = src->len;
     dst->reg_node = src->reg_node;
-    bitset_clone(&dst->def, &src->def);
-    bitset_clone(&dst->use, &src->use);
+    dst->def = src->def;
+    dst->use = src->use;
     dst->flag.is_const = src->flag.is_const;
     dst->ld_imm = src->ld_imm;
     dst->cfg = cfg;
@@ -162,10 +189,10 @@ struct minst*       minst_new_t(struct minst_cfg *cfg, enum minst_type type, voi
     struct minst_blk *blk = cfg->blk;
     struct minst *minst = minst_new(blk, NULL, 0, NULL);
 
-    minst->addr = blk->text_sec.data + blk->text_sec.len;
+    minst->addr = minst_blk_text_alloc(blk, len);
     minst->len = len;
-    blk->text_sec.len += len;
-    memcpy(minst->addr, code, len);
+    if (code)
+        memcpy(minst->addr, code, len);
 
     minst->type = type;
     minst->reg_node = reg_node;
@@ -181,15 +208,15 @@ struct minst*       minst_new_t(struct minst_cfg *cfg, enum minst_type type, voi
 struct minst*       minst_change(struct minst *minst, enum minst_type type, void *reg_node, unsigned char *code, int len)
 {
     struct minst_blk *blk = minst->cfg->blk;
-    minst->addr = blk->text_sec.data + blk->text_sec.len;
 
-    minst->addr = blk->text_sec.data + blk->text_sec.len;
+    minst->addr = minst_blk_text_alloc(blk, len);
     minst->len = len;
-    blk->text_sec.len += len;
-    memcpy(minst->addr, code, len);
+    if (code)
+        memcpy(minst->addr, code, len);
 
     minst->type = type;
     minst->reg_node = reg_node;
+    minst->flag.decoded = 0;
 
     return minst;
 }
@@ -233,7 +260,7 @@ int                 minst_preds_count(struct minst *minst)
 
 struct minst_cfg*   minst_cfg_new(struct minst_blk *blk, struct minst *start, struct minst *end)
 {
-    struct minst_cfg *cfg = calloc(1, sizeof (cfg[0]));
+    struct minst_cfg *cfg = marena_alloc(&blk->arena, sizeof (cfg[0]));
 
     if (NULL == cfg)
         vm_error("minst_cfg_new() failure");
@@ -243,13 +270,38 @@ struct minst_cfg*   minst_cfg_new(struct minst_blk *blk, struct minst *start, st
     cfg->end = start;
     cfg->blk = blk;
     dynarray_add(&blk->allcfg, cfg);
+    minst_blk_dom_invalidate(blk);
 
     return cfg;
 }
 
 void                minst_cfg_delete(struct minst_cfg *cfg)
 {
-    free(cfg);
+    /* cfg 在 blk->arena 里，随 blk 一起释放 */
+}
+
+static struct minst_node*   minst_node_alloc(struct minst_blk *blk)
+{
+    struct minst_node *node = blk->free_nodes;
+
+    if (node) {
+        blk->free_nodes = node->next;
+        memset(node, 0, sizeof (node[0]));
+        return node;
+    }
+
+    node = marena_alloc(&blk->arena, sizeof (node[0]));
+    if (!node)
+        vm_error("minst_node_alloc() failure");
+
+    return node;
+}
+
+static void                 minst_node_free(struct minst_blk *blk, struct minst_node *node)
+{
+    node->minst = NULL;
+    node->next = blk->free_nodes;
+    blk->free_nodes = node;
 }
 
 struct minst*       minst_blk_find(struct minst_blk *blk, unsigned long addr)
@@ -272,16 +324,17 @@ void                minst_succ_add(struct minst *minst, struct minst *succ, int
         tnode = &minst->succs;
     }
     else {
-        tnode = calloc(1, sizeof (tnode[0]));
-        if (!tnode)
-            vm_error("minst_succ_add() calloc failure");
-
+        tnode = minst_node_alloc(minst->blk);
         tnode->next = minst->succs.next;
         minst->succs.next = tnode;
     }
 
     tnode->minst = succ;
     tnode->f.true_label = truel;
+
+    /* cfg 的支配树和SSA只看后继边，前驱边跟着后继边一起改，这里失效一次就够了 */
+    minst_blk_dom_invalidate(minst->blk);
+    minst_blk_ssa_invalidate(minst->blk);
 }
 
 void                minst_pred_add(struct minst *minst, struct minst *pred)
@@ -294,10 +347,7 @@ void                minst_pred_add(struct minst *minst, struct minst *pred)
     if (!minst->preds.minst)
         minst->preds.minst = pred;
     else {
-        tnode = calloc(1, sizeof (tnode[0]));
-        if (!tnode)
-            vm_error("minst_pred_add() calloc failure");
-
+        tnode = minst_node_alloc(minst->blk);
         tnode->minst = pred;
         tnode->next = minst->preds.next;
 
@@ -309,6 +359,9 @@ void                minst_succ_del(struct minst *minst, struct minst *succ)
 {
     struct minst_node *succ_node = &minst->succs, *prev_node;
 
+    minst_blk_dom_invalidate(minst->blk);
+    minst_blk_ssa_invalidate(minst->blk);
+
     for (; succ_node; prev_node = succ_node, succ_node = succ_node->next) {
         if (succ_node->minst == succ) {
             for (; succ_node->next; prev_node = succ_node, succ_node = succ_node->next) {
@@ -321,7 +374,7 @@ void                minst_succ_del(struct minst *minst, struct minst *succ)
                 succ_node->next = NULL;
             }
             else {
-                free(prev_node->next);
+                minst_node_free(minst->blk, prev_node->next);
                 prev_node->next = NULL;
             }
 
@@ -344,7 +397,7 @@ void                minst_pred_del(struct minst *minst, struct minst *pred)
                 pred_node->next = NULL;
             }
             else {
-                free(prev_node->next);
+                minst_node_free(minst->blk, prev_node->next);
                 prev_node->next = NULL;
             }
 
@@ -358,7 +411,7 @@ void                minst_del_from_cfg(struct minst *minst)
     struct minst_cfg *cfg = minst->cfg;
     struct minst_node *pred_node, *succ_node;
     struct minst *pred, *succ = minst->succs.minst;
-    int inst_count = minst_cfg_inst_count(cfg);
+    int inst_count = minst_cfg_inst_count(cfg), ssa_valid = minst->blk->ssa.valid;
 
     if (minst_succs_count(minst) > 1)
         vm_error("cant delete succs > 1 minst[%d]\n", minst->id);
@@ -398,6 +451,13 @@ void                minst_del_from_cfg(struct minst *minst)
 
     /* 打上dead_code的标志 */
     minst->flag.dead_code = 1;
+
+    /* 块之间的路径没变，SSA 不用重建，删掉的定值在展开时跳过，use-def 链在这里接好 */
+    minst->blk->ssa.valid = ssa_valid;
+    minst_du_del(minst);
+
+    minst_df_dirty(&minst->blk->live_df, minst);
+    minst_blk_dom_invalidate(minst->blk);
 }
 
 void                minst_replace_edge(struct minst *from, struct minst *to, struct minst *rep)
@@ -412,6 +472,8 @@ void                minst_replace_edge(struct minst *from, struct minst *to, str
 
     minst_pred_del(to, from);
     minst_pred_add(rep, from);
+    minst_blk_dom_invalidate(from->blk);
+    minst_blk_ssa_invalidate(from->blk);
 }
 
 void                minst_blk_gen_cfg(struct minst_blk *blk)
@@ -540,8 +602,7 @@ void                minst_blk_live_epilogue_add(struct minst_blk *blk)
             minst_del_edge(m, succ);
 
         minst = minst_new(blk, NULL, 0, NULL);
-        minst->addr = blk->text_sec.data + blk->text_sec.len;
-        blk->text_sec.len += 1;
+        minst->addr = minst_blk_text_alloc(blk, 1);
         minst->len = 1;
 
         minst->flag.epilogue = 1;
@@ -554,12 +615,12 @@ void                minst_blk_live_epilogue_add(struct minst_blk *blk)
         minst_add_edge(m, minst);
 
         if (m->type == mtype_bl) {
-            bitset_clear(&m->use);
+            live_regs_clear(&m->use);
         }
 
         /* pop 指令非常特殊 */
         while (m->type == mtype_pop) {
-            bitset_foreach(&m->def, j) {
+            live_regs_foreach(&m->def, j) {
                 live_use_set(blk, j);
             }
 
@@ -569,258 +630,3200 @@ void                minst_blk_live_epilogue_add(struct minst_blk *blk)
 }
 
 
-int                 minst_blk_liveness_calc(struct minst_blk *blk)
+static int*         minst_df_ints(int num)
+{
+    int *p = (int *)calloc(num + 1, sizeof (p[0]));
+    if (!p)
+        vm_error("minst_df_ints() calloc failure, %d", num);
+
+    return p;
+}
+
+static void         minst_df_edges_free(struct minst_df_edges *e)
+{
+    if (e->start)   free(e->start);
+    if (e->to)      free(e->to);
+    e->start = e->to = NULL;
+}
+
+/* 把 num 条边 from[i]->to[i] 按起点压缩存储 */
+static void         minst_df_edges_build(struct minst_df_edges *e, int nodes, int *from, int *to, int num)
+{
+    int i, *pos;
+
+    minst_df_edges_free(e);
+
+    e->start = minst_df_ints(nodes + 1);
+    e->to = minst_df_ints(num);
+    pos = minst_df_ints(nodes);
+
+    for (i = 0; i < num; i++)
+        e->start[from[i] + 1]++;
+
+    for (i = 0; i < nodes; i++) {
+        e->start[i + 1] += e->start[i];
+        pos[i] = e->start[i];
+    }
+
+    for (i = 0; i < num; i++)
+        e->to[pos[from[i]]++] = to[i];
+
+    free(pos);
+}
+
+static void         minst_df_graph_uninit(struct minst_df_graph *g)
+{
+    if (g->inst_start)  free(g->inst_start);
+    if (g->insts)       free(g->insts);
+    if (g->inst_blk)    free(g->inst_blk);
+    if (g->rpo)         free(g->rpo);
+
+    minst_df_edges_free(&g->succs);
+    minst_df_edges_free(&g->preds);
+    minst_df_edges_free(&g->succs_r);
+    minst_df_edges_free(&g->preds_r);
+
+    memset(g, 0, sizeof (g[0]));
+}
+
+/* 从 nodes 里数出活着的指令，one 返回最后一个 */
+static int          minst_df_live_nodes(struct minst_node *nodes, struct minst **one)
+{
+    struct minst_node *node;
+    int num = 0;
+
+    for (node = nodes; node; node = node->next) {
+        if (!node->minst || minst_is_dead_code(node->minst)) continue;
+        *one = node->minst;
+        num++;
+    }
+
+    return num;
+}
+
+/* 沿着 e 做DFS，逆后序写到 rpo 里，返回写了多少个节点。starts 为空时从所有节点按编号出发，
+否则只从 starts 出发，每棵DFS树的根在 root 里标1(root可以为空) */
+static int          minst_df_order(int num, struct minst_df_edges *e, int *starts, int nstarts, int *rpo, int *root)
+{
+    int *stack, *edge, *visited, top, b, i, s, t, cnt = 0;
+
+    stack = minst_df_ints(num);
+    edge = minst_df_ints(num);
+    visited = minst_df_ints(num);
+
+    for (i = 0; i < (starts ? nstarts : num); i++) {
+        b = starts ? starts[i] : i;
+        if (visited[b]) continue;
+
+        if (root) root[b] = 1;
+        visited[b] = 1;
+        stack[top = 0] = b;
+        edge[b] = e->start[b];
+
+        while (top >= 0) {
+            b = stack[top];
+            if (edge[b] < e->start[b + 1]) {
+                s = e->to[edge[b]++];
+                if (!visited[s]) {
+                    visited[s] = 1;
+                    edge[s] = e->start[s];
+                    stack[++top] = s;
+                }
+                continue;
+            }
+
+            rpo[cnt++] = b;
+            top--;
+        }
+    }
+
+    for (i = 0; i < cnt / 2; i++) {
+        t = rpo[i];
+        rpo[i] = rpo[cnt - 1 - i];
+        rpo[cnt - 1 - i] = t;
+    }
+
+    free(stack);
+    free(edge);
+    free(visited);
+
+    return cnt;
+}
+
+static int          minst_dom_intersect(int *idom, int *order, int a, int b)
+{
+    while (a != b) {
+        while ((a >= 0) && ((b < 0) || (order[a] > order[b]))) a = idom[a];
+        while ((b >= 0) && ((a < 0) || (order[b] > order[a]))) b = idom[b];
+    }
+
+    return a;
+}
+
+/* Cooper, Harvey, Kennedy 的迭代支配算法。rpo 里的前 cnt 个节点参与计算，root 标1的节点
+直接挂在虚拟根下面(idom = -1)，没有参与计算的节点 idom = -2 */
+static void         minst_dom_solve(int num, struct minst_df_edges *preds, int *rpo, int cnt, int *root, int *idom)
+{
+    int *order, i, j, b, p, nidom, changed = 1;
+
+    order = minst_df_ints(num);
+
+    for (b = 0; b < num; b++)
+        idom[b] = -2;
+    for (i = 0; i < cnt; i++) {
+        order[rpo[i]] = i;
+        idom[rpo[i]] = root[rpo[i]] ? -1 : -2;
+    }
+
+    while (changed) {
+        changed = 0;
+        for (i = 0; i < cnt; i++) {
+            b = rpo[i];
+            if (root[b]) continue;
+
+            for (j = preds->start[b], nidom = -2; j < preds->start[b + 1]; j++) {
+                p = preds->to[j];
+                if (idom[p] == -2) continue;
+                nidom = (nidom == -2) ? p : minst_dom_intersect(idom, order, p, nidom);
+            }
+
+            if (idom[b] != nidom) {
+                idom[b] = nidom;
+                changed = 1;
+            }
+        }
+    }
+
+    free(order);
+}
+
+/* 给 idom 描述的树做先序/后序编号，idom = -2 的节点不在树上，编号是-1 */
+static void         minst_dom_number(int num, int *idom, int *pre, int *post)
+{
+    struct minst_df_edges kids = {0};
+    int *from, *to, *stack, *edge, i, b, k, top, cnt = 0, seq = 0;
+
+    from = minst_df_ints(num);
+    to = minst_df_ints(num);
+    for (b = 0; b < num; b++) {
+        pre[b] = post[b] = -1;
+        if (idom[b] < 0) continue;
+        from[cnt] = idom[b];
+        to[cnt++] = b;
+    }
+    minst_df_edges_build(&kids, num, from, to, cnt);
+
+    stack = minst_df_ints(num);
+    edge = minst_df_ints(num);
+    for (i = 0; i < num; i++) {
+        if (idom[i] != -1) continue;
+
+        pre[i] = seq++;
+        edge[i] = kids.start[i];
+        stack[top = 0] = i;
+        while (top >= 0) {
+            b = stack[top];
+            if (edge[b] < kids.start[b + 1]) {
+                k = kids.to[edge[b]++];
+                pre[k] = seq++;
+                edge[k] = kids.start[k];
+                stack[++top] = k;
+                continue;
+            }
+
+            post[b] = seq++;
+            top--;
+        }
+    }
+
+    minst_df_edges_free(&kids);
+    free(from);
+    free(to);
+    free(stack);
+    free(edge);
+}
+
+#define minst_dom_contains(pre, post, a, b) \
+    (((pre)[a] >= 0) && ((pre)[b] >= 0) && ((pre)[a] <= (pre)[b]) && ((post)[b] <= (post)[a]))
+
+/* 两条指令 m->s 能放进同一个块，要求这条边两头都是唯一的，并且没有其他指令
+从任何方向引用到这条边的中间 */
+static void         minst_df_graph_build(struct minst_df_graph *g, struct minst_blk *blk)
+{
+    int n = blk->allinst.len, i, j, b, num, pos, *sref, *pref, *next, *linked, *from, *to;
+    struct minst *m, *s, *p;
+    struct minst_node *node;
+
+    minst_df_graph_uninit(g);
+
+    g->inst_num = n;
+    g->inst_blk = minst_df_ints(n);
+    g->insts = minst_df_ints(n);
+    g->inst_start = minst_df_ints(n + 1);
+    sref = minst_df_ints(n);
+    pref = minst_df_ints(n);
+    next = minst_df_ints(n);
+    linked = minst_df_ints(n);
+
+    for (i = 0, num = 0; i < n; i++) {
+        m = blk->allinst.ptab[i];
+        g->inst_blk[i] = -1;
+        next[i] = -1;
+        if (minst_is_dead_code(m)) continue;
+
+        minst_succs_foreach(m, node) {
+            if (node->minst && !minst_is_dead_code(node->minst)) {
+                sref[node->minst->id]++;
+                num++;
+            }
+        }
+        minst_preds_foreach(m, node) {
+            if (node->minst && !minst_is_dead_code(node->minst)) {
+                pref[node->minst->id]++;
+                num++;
+            }
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        m = blk->allinst.ptab[i];
+        if (minst_is_dead_code(m)
+            || (minst_df_live_nodes(&m->succs, &s) != 1)
+            || (s == m)
+            || (sref[s->id] != 1)
+            || (pref[m->id] != 1)
+            || (minst_df_live_nodes(&s->preds, &p) != 1)
+            || (p != m))
+            continue;
+
+        next[i] = s->id;
+        linked[s->id] = 1;
+    }
+
+    /* 先从没有被链进来的指令开始切，剩下的是首尾相连的环，随便挑一条开始 */
+    for (j = 0, pos = 0, b = 0; j < 2; j++) {
+        for (i = 0; i < n; i++) {
+            m = blk->allinst.ptab[i];
+            if ((g->inst_blk[i] >= 0) || minst_is_dead_code(m))
+                continue;
+            if (!j && linked[i])
+                continue;
+
+            g->inst_start[b] = pos;
+            for (; m && (g->inst_blk[m->id] < 0); m = (next[m->id] >= 0) ? blk->allinst.ptab[next[m->id]] : NULL) {
+                g->inst_blk[m->id] = b;
+                g->insts[pos++] = m->id;
+            }
+            b++;
+        }
+    }
+    g->num = b;
+    g->inst_start[b] = pos;
+
+    from = minst_df_ints(num);
+    to = minst_df_ints(num);
+
+    for (b = 0, num = 0; b < g->num; b++) {
+        m = blk->allinst.ptab[g->insts[g->inst_start[b + 1] - 1]];
+        minst_succs_foreach(m, node) {
+            if (!node->minst || minst_is_dead_code(node->minst)) continue;
+            from[num] = b;
+            to[num++] = g->inst_blk[node->minst->id];
+        }
+    }
+    minst_df_edges_build(&g->succs, g->num, from, to, num);
+    minst_df_edges_build(&g->succs_r, g->num, to, from, num);
+
+    for (b = 0, num = 0; b < g->num; b++) {
+        m = blk->allinst.ptab[g->insts[g->inst_start[b]]];
+        minst_preds_foreach(m, node) {
+            if (!node->minst || minst_is_dead_code(node->minst)) continue;
+            from[num] = b;
+            to[num++] = g->inst_blk[node->minst->id];
+        }
+    }
+    minst_df_edges_build(&g->preds, g->num, from, to, num);
+    minst_df_edges_build(&g->preds_r, g->num, to, from, num);
+
+    g->rpo = minst_df_ints(g->num);
+    minst_df_order(g->num, &g->succs, NULL, 0, g->rpo, NULL);
+
+    free(from);
+    free(to);
+    free(sref);
+    free(pref);
+    free(next);
+    free(linked);
+}
+
+void                minst_df_init(struct minst_df *df, enum minst_df_dir dir, minst_df_summary summary, void *arg)
+{
+    memset(df, 0, sizeof (df[0]));
+
+    df->dir = dir;
+    df->summary = summary;
+    df->arg = arg;
+
+    bitmat_init(&df->in, 0, 0);
+    bitmat_init(&df->out, 0, 0);
+    bitmat_init(&df->gen, 0, 0);
+    bitmat_init(&df->kill, 0, 0);
+}
+
+void                minst_df_uninit(struct minst_df *df)
+{
+    minst_df_graph_uninit(&df->g);
+
+    if (df->dirty)      free(df->dirty);
+    if (df->touched)    free(df->touched);
+    df->dirty = df->touched = NULL;
+
+    bitmat_uninit(&df->in);
+    bitmat_uninit(&df->out);
+    bitmat_uninit(&df->gen);
+    bitmat_uninit(&df->kill);
+}
+
+/* 矩阵大小不变时只清零，省掉重新分配 */
+static void         minst_bitmat_fit(struct bitmat *m, int rows, int cols, int clear)
+{
+    if ((m->rows == rows) && (m->cols == cols)) {
+        if (clear) bitmat_clear(m);
+        return;
+    }
+
+    bitmat_uninit(m);
+    if (!bitmat_init(m, rows, cols))
+        vm_error("minst_bitmat_fit() failed with alloc %dx%d", rows, cols);
+}
+
+/* 从 seed 里标记的块开始跑 worklist，seed 为空时所有块都入队 */
+static void         minst_df_run(struct minst_df *df, unsigned char *seed)
+{
+    struct minst_df_graph *g = &df->g;
+    struct minst_df_edges *src, *dep;
+    struct bitmat *x, *y;
+    unsigned int *xb, *yb, *gen, *kill, *t;
+    int *queue, *inq, head, num, i, b, cols4;
+
+    if (!g->num) return;
+
+    /* 前向问题 x = in，y = out，后向问题反过来，y = gen | (x & ~kill)，
+    x 是 src 里所有块的 y 的并集，y 变了以后 dep 里的块要重新算 */
+    if (df->dir == MINST_DF_FORWARD) {
+        x = &df->in, y = &df->out;
+        src = &g->preds, dep = &g->preds_r;
+    }
+    else {
+        x = &df->out, y = &df->in;
+        src = &g->succs, dep = &g->succs_r;
+    }
+
+    queue = minst_df_ints(g->num);
+    inq = minst_df_ints(g->num);
+    cols4 = df->in.cols4;
+
+    for (i = 0, num = 0; i < g->num; i++) {
+        b = (df->dir == MINST_DF_FORWARD) ? g->rpo[i] : g->rpo[g->num - 1 - i];
+        if (seed && !seed[b]) continue;
+        queue[num++] = b;
+        inq[b] = 1;
+    }
+
+    for (head = 0; num > 0; num--) {
+        b = queue[head];
+        head = (head + 1) % g->num;
+        inq[b] = 0;
+
+        xb = bitmat_row_data(x, b);
+        yb = bitmat_row_data(y, b);
+        gen = bitmat_row_data(&df->gen, b);
+        kill = bitmat_row_data(&df->kill, b);
+
+        for (i = src->start[b]; i < src->start[b + 1]; i++) {
+            t = bitmat_row_data(y, src->to[i]);
+            bitset_words_or(xb, t, cols4);
+        }
+
+        if (!bitset_words_or_andnot(yb, gen, xb, kill, cols4)) continue;
+
+        for (i = dep->start[b]; i < dep->start[b + 1]; i++) {
+            if (inq[dep->to[i]]) continue;
+            inq[dep->to[i]] = 1;
+            queue[(head + num - 1) % g->num] = dep->to[i];
+            num++;
+        }
+    }
+
+    free(queue);
+    free(inq);
+}
+
+int                 minst_df_solve(struct minst_df *df, struct minst_blk *blk, int bits)
+{
+    struct minst_df_graph *g = &df->g;
+    int b;
+
+    df->blk = blk;
+
+    minst_df_graph_build(g, blk);
+
+    minst_bitmat_fit(&df->in, g->num, bits, 1);
+    minst_bitmat_fit(&df->out, g->num, bits, 1);
+    minst_bitmat_fit(&df->gen, g->num, bits, 1);
+    minst_bitmat_fit(&df->kill, g->num, bits, 1);
+
+    if (df->dirty)      free(df->dirty);
+    if (df->touched)    free(df->touched);
+    df->dirty = (unsigned char *)calloc(g->num + 1, 1);
+    df->touched = (unsigned char *)calloc(g->num + 1, 1);
+    if (!df->dirty || !df->touched)
+        vm_error("minst_df_solve() calloc failure");
+    df->dirty_num = 0;
+
+    for (b = 0; b < g->num; b++)
+        df->summary(df, b, bitmat_row_data(&df->gen, b), bitmat_row_data(&df->kill, b));
+
+    minst_df_run(df, NULL);
+
+    return 0;
+}
+
+void                minst_df_dirty(struct minst_df *df, struct minst *m)
+{
+    int b;
+
+    if ((m->id >= df->g.inst_num) || ((b = df->g.inst_blk[m->id]) < 0) || df->dirty[b])
+        return;
+
+    df->dirty[b] = 1;
+    df->dirty_num++;
+}
+
+int                 minst_df_update(struct minst_df *df)
+{
+    struct minst_df_graph *g = &df->g;
+    struct minst_df_edges *dep = (df->dir == MINST_DF_FORWARD) ? &g->preds_r : &g->succs_r;
+    int *stack, top = -1, i, b, num = 0;
+
+    if (!df->dirty_num)
+        return 0;
+
+    /* 集合只会在脏块以及依赖它们的块上变化，既可能变大也可能变小，所以这些块先清零，
+    然后只让它们重新进 worklist 求最小不动点，其余块的值保持不变 */
+    memset(df->touched, 0, g->num);
+    stack = minst_df_ints(g->num);
+
+    for (b = 0; b < g->num; b++) {
+        if (!df->dirty[b]) continue;
+
+        df->dirty[b] = 0;
+        memset(bitmat_row_data(&df->gen, b), 0, df->gen.cols4 * sizeof (unsigned int));
+        memset(bitmat_row_data(&df->kill, b), 0, df->kill.cols4 * sizeof (unsigned int));
+        df->summary(df, b, bitmat_row_data(&df->gen, b), bitmat_row_data(&df->kill, b));
+
+        if (!df->touched[b]) {
+            df->touched[b] = 1;
+            stack[++top] = b;
+        }
+    }
+    df->dirty_num = 0;
+
+    while (top >= 0) {
+        b = stack[top--];
+        num++;
+        memset(bitmat_row_data(&df->in, b), 0, df->in.cols4 * sizeof (unsigned int));
+        memset(bitmat_row_data(&df->out, b), 0, df->out.cols4 * sizeof (unsigned int));
+
+        for (i = dep->start[b]; i < dep->start[b + 1]; i++) {
+            if (df->touched[dep->to[i]]) continue;
+            df->touched[dep->to[i]] = 1;
+            stack[++top] = dep->to[i];
+        }
+    }
+
+    free(stack);
+
+    minst_df_run(df, df->touched);
+
+    return num;
+}
+
+static void         live_regs_to_u32(struct live_regs *r, unsigned int *d)
+{
+    int w;
+
+    for (w = 0; w < LIVE_REGS_WORDS; w++) {
+        d[2 * w] = (unsigned int)r->w[w];
+        d[2 * w + 1] = (unsigned int)(r->w[w] >> 32);
+    }
+}
+
+static void         live_regs_from_u32(struct live_regs *r, unsigned int *d)
+{
+    int w;
+
+    for (w = 0; w < LIVE_REGS_WORDS; w++)
+        r->w[w] = d[2 * w] | ((uint64_t)d[2 * w + 1] << 32);
+}
+
+/* 活跃性是后向问题，gen = use，kill = def，块内倒着合成 */
+static void         minst_live_summary(struct minst_df *df, int b, unsigned int *gen, unsigned int *kill)
+{
+    struct minst_df_graph *g = &df->g;
+    struct live_regs ug, uk;
+    struct minst *minst;
+    int i, w;
+
+    live_regs_clear(&ug);
+    live_regs_clear(&uk);
+
+    for (i = g->inst_start[b + 1] - 1; i >= g->inst_start[b]; i--) {
+        minst = df->blk->allinst.ptab[g->insts[i]];
+        if (minst_is_dead_code(minst)) continue;
+
+        for (w = 0; w < LIVE_REGS_WORDS; w++) {
+            ug.w[w] = minst->use.w[w] | (ug.w[w] & ~minst->def.w[w]);
+            uk.w[w] |= minst->def.w[w];
+        }
+    }
+
+    live_regs_to_u32(&ug, gen);
+    live_regs_to_u32(&uk, kill);
+}
+
+/* 把块的 out 倒着推回块内每条指令，in = use | (out - def)，out = 后继的 in，
+增量求解以后块里可能有已经删掉的指令，它们的集合清空 */
+static void         minst_live_expand(struct minst_blk *blk, int b)
+{
+    struct minst_df *df = &blk->live_df;
+    struct minst_df_graph *g = &df->g;
+    struct minst *minst;
+    struct live_regs out;
+    int i, w;
+
+    live_regs_from_u32(&out, bitmat_row_data(&df->out, b));
+
+    for (i = g->inst_start[b + 1] - 1; i >= g->inst_start[b]; i--) {
+        minst = blk->allinst.ptab[g->insts[i]];
+        if (minst_is_dead_code(minst)) {
+            live_regs_clear(&minst->in);
+            live_regs_clear(&minst->out);
+            continue;
+        }
+
+        minst->out = out;
+        for (w = 0; w < LIVE_REGS_WORDS; w++)
+            minst->in.w[w] = minst->use.w[w] | (out.w[w] & ~minst->def.w[w]);
+        out = minst->in;
+    }
+}
+
+int                 minst_blk_liveness_calc(struct minst_blk *blk)
+{
+    struct minst_df *df = &blk->live_df;
+    struct minst *minst;
+    int i, b;
+
+    minst_df_solve(df, blk, LIVE_REGS_NUM);
+
+    for (b = 0; b < df->g.num; b++)
+        minst_live_expand(blk, b);
+
+    for (i = 0; i < blk->allinst.len; i++) {
+        if (df->g.inst_blk[i] >= 0) continue;
+
+        minst = blk->allinst.ptab[i];
+        live_regs_clear(&minst->in);
+        live_regs_clear(&minst->out);
+    }
+
+    return 0;
+}
+
+int                 minst_blk_liveness_update(struct minst_blk *blk)
+{
+    struct minst_df *df = &blk->live_df;
+    int b;
+
+    if (!minst_df_update(df))
+        return 0;
+
+    for (b = 0; b < df->g.num; b++) {
+        if (df->touched[b])
+            minst_live_expand(blk, b);
+    }
+
+    return 0;
+}
+
+int                 minst_blk_dead_code_elim(struct minst_blk *blk)
+{
+    struct minst_cfg *cfg;
+    struct minst *minst;
+    int changed = 1, i, w, ret = 0, full;
+    uint64_t live;
+
+    /* 删掉一条死代码只会让别的指令的活跃集合变小，所以同一轮里找到的死代码可以一起删，
+    不会误删。进来时的活跃信息不一定是最新的(前面改过cfg)，第一次重新计算要全量做，
+    之后只有删指令，增量更新就行 */
+    for (full = 1; changed; full = 0) {
+        changed = 0;
+        for (i = 0; i < blk->allinst.len; i++) {
+            minst = blk->allinst.ptab[i];
+            /* 
+            1. 死代码删除只在四元式中进行，函数不参与死代码删除计算
+            2. str指令不参与计算，因为有很强的副作用 */
+            if (minst->flag.dead_code || minst->flag.prologue || minst->flag.epilogue 
+                || (minst->type == mtype_bl)
+                || (minst->type == mtype_str)
+                || (minst->type == mtype_ldr))
+                continue;
+
+            /* 四元式一定有def的，没有def的指令一般是 bl, it, cmp等等*/
+            if (live_regs_is_empty(&minst->def))
+                continue;
+
+            for (w = 0, live = 0; w < LIVE_REGS_WORDS; w++)
+                live |= minst->def.w[w] & minst->out.w[w];
+
+            if (!live) {
+                minst_del_from_cfg(minst);
+                //printf("dead code elim, inst[%d]\n", minst->id);
+                ret = changed = 1;
+            }
+        }
+
+        if (full)
+            minst_blk_liveness_calc(blk);
+        else if (changed)
+            minst_blk_liveness_update(blk);
+    }
+
+    /* 删除一个节点且这个节点就是跳转指令的的cfg*/
+    for (i = 0; i < blk->allcfg.len; i++) {
+        cfg = blk->allcfg.ptab[i];
+        if (cfg->flag.dead_code) continue;
+        if (cfg->start != cfg->end) continue;
+        if (cfg->start->type != mtype_b) continue;
+        if ((minst_preds_count(cfg->start) == 1) && (minst_succs_count(cfg->end) == 1)) {
+            minst_del_from_cfg(cfg->start);
+        }
+    }
+
+    return ret;
+}
+
+int                 minst_get_def(struct minst *minst)
+{
+    if (minst->ld == -1)
+        return minst->ld;
+
+    return minst->ld = live_regs_next(&minst->def, 0);
+}
+
+int                 minst_get_use(struct minst *minst)
+{
+    int pos = live_regs_next(&minst->use, 0);
+
+    if (pos != ARM_REG_APSR) return pos;
+
+    int pos1 = live_regs_next(&minst->use, pos + 1);
+
+    if (pos1 != -1) return pos1;
+
+    return pos;
+}
+
+/* 到达定值是前向问题，每条有定值的指令 gen 自己，kill 同一个寄存器的其他定值 */
+static void         minst_rd_summary(struct minst_df *df, int b, unsigned int *gen, unsigned int *kill)
+{
+    struct minst_blk *blk = df->blk;
+    struct minst_df_graph *g = &df->g;
+    unsigned int *d, k;
+    int i, id, w, cols4 = df->gen.cols4;
+
+    for (i = g->inst_start[b]; i < g->inst_start[b + 1]; i++) {
+        id = g->insts[i];
+        if (blk->rd.def[id] < 0) continue;
+
+        d = bitmat_row_data(&blk->rd.defs, blk->rd.def[id]);
+        for (w = 0; w < cols4; w++) {
+            k = d[w];
+            if (w == id / 32)
+                k &= ~(1u << (id % 32));
+            gen[w] &= ~k;
+            kill[w] |= k;
+        }
+        gen[id / 32] |= 1u << (id % 32);
+    }
+}
+
+/* 每条指令的 in/out/kills 集合调整到n个，多出来的释放掉 */
+static void         minst_rd_rows_fit(struct minst_blk *blk, int n)
+{
+    struct rset **rows[3] = { &blk->rd.in, &blk->rd.out, &blk->rd.kills }, *p;
+    int i, j;
+
+    for (j = 0; j < 3; j++) {
+        for (i = n; i < blk->rd.num; i++)
+            rset_uninit(&(*rows[j])[i]);
+
+        if (!n) {
+            if (*rows[j]) free(*rows[j]);
+            *rows[j] = NULL;
+            continue;
+        }
+
+        p = (struct rset *)realloc(*rows[j], n * sizeof (p[0]));
+        if (!p)
+            vm_error("minst_rd_rows_fit() realloc failure, %d", n);
+        for (i = blk->rd.num; i < n; i++)
+            rset_init(&p[i]);
+        *rows[j] = p;
+    }
+
+    blk->rd.num = n;
+}
+
+#define minst_rd_rows_clear(blk, id)        do { \
+        rset_clear(&(blk)->rd.in[id]); \
+        rset_clear(&(blk)->rd.out[id]); \
+        rset_clear(&(blk)->rd.kills[id]); \
+    } while (0)
+
+/* 从块的 in 开始顺着算出块内每条指令的 in/out/kills，先在定长的位数组上算，再压成 rset */
+static void         minst_rd_expand(struct minst_blk *blk, int b)
+{
+    struct minst_df_graph *g = &blk->rd.df.g;
+    unsigned int *x, *kills, *d, bit;
+    int i, id, w, cols4 = blk->rd.defs.cols4;
+
+    x = (unsigned int *)calloc(cols4 * 2 + 1, sizeof (x[0]));
+    if (!x)
+        vm_error("minst_rd_expand() calloc failure, %d", cols4);
+    kills = x + cols4;
+
+    memcpy(x, bitmat_row_data(&blk->rd.df.in, b), cols4 * sizeof (x[0]));
+
+    for (i = g->inst_start[b]; i < g->inst_start[b + 1]; i++) {
+        id = g->insts[i];
+        if (blk->rd.def[id] == -2) continue;
+
+        if (!rset_from_words(&blk->rd.in[id], x, cols4))
+            vm_error("minst_rd_expand() failed with rset alloc");
+
+        if (blk->rd.def[id] < 0) {
+            rset_clear(&blk->rd.kills[id]);
+            rset_clone(&blk->rd.out[id], &blk->rd.in[id]);
+            continue;
+        }
+
+        d = bitmat_row_data(&blk->rd.defs, blk->rd.def[id]);
+        for (w = 0; w < cols4; w++) {
+            bit = (w == id / 32) ? (1u << (id % 32)) : 0;
+            kills[w] = d[w] & ~bit;
+            x[w] = (x[w] & ~kills[w]) | bit;
+        }
+
+        if (!rset_from_words(&blk->rd.kills[id], kills, cols4) || !rset_from_words(&blk->rd.out[id], x, cols4))
+            vm_error("minst_rd_expand() failed with rset alloc");
+    }
+
+    free(x);
+}
+
+struct rset*        minst_rd_row(struct minst *m, struct rset *rows)
+{
+    struct minst_blk *blk = m->blk;
+    int b;
+
+    if ((m->id < blk->rd.df.g.inst_num) && ((b = blk->rd.df.g.inst_blk[m->id]) >= 0) && !blk->rd.expanded[b]) {
+        blk->rd.expanded[b] = 1;
+        minst_rd_expand(blk, b);
+    }
+
+    if (!rows || (m->id >= blk->rd.num))
+        return &blk->rd.empty;
+
+    return &rows[m->id];
+}
+
+int                 minst_blk_gen_reaching_definitions(struct minst_blk *blk)
+{
+    struct minst *minst;
+    int i, r, n = blk->allinst.len;
+
+    /* 块内指令的集合在展开时整个覆盖，这里只清不参与计算的 */
+    minst_rd_rows_fit(blk, n);
+    /* 编号超过 REGS_NUM 的临时变量 blk->defs 里没有记录，对应的行留空，这种定值不 kill 别的定值 */
+    minst_bitmat_fit(&blk->rd.defs, LIVE_REGS_NUM, n, 1);
+
+    for (r = 0; r < REGS_NUM; r++)
+        bitset_clone(bitmat_row(&blk->rd.defs, r), &blk->defs[r]);
+
+    if (blk->rd.def) free(blk->rd.def);
+    blk->rd.def = minst_df_ints(n);
+
+    for (i = 0; i < n; i++) {
+        minst = blk->allinst.ptab[i];
+        if (minst->flag.epilogue || minst_is_dead_code(minst))
+            blk->rd.def[i] = -2;
+        else
+            blk->rd.def[i] = (minst_get_def(minst) < 0) ? -1 : minst_get_def(minst);
+    }
+
+    minst_df_solve(&blk->rd.df, blk, n);
+
+    for (i = 0; i < n; i++) {
+        if ((blk->rd.def[i] != -2) && (blk->rd.df.g.inst_blk[i] >= 0))
+            continue;
+
+        minst_rd_rows_clear(blk, i);
+    }
+
+    if (blk->rd.expanded) free(blk->rd.expanded);
+    blk->rd.expanded = (unsigned char *)calloc(blk->rd.df.g.num + 1, 1);
+    if (!blk->rd.expanded)
+        vm_error("minst_blk_gen_reaching_definitions() calloc failure");
+
+    return 0;
+}
+
+static int          minst_ssa_val_new(struct minst_ssa *s, int kind, int reg, int kill_reg, int inst, int prev)
+{
+    struct minst_ssa_val *v;
+
+    if (s->val_num == s->val_cap) {
+        s->val_cap = s->val_cap ? (s->val_cap * 2) : 1024;
+        s->vals = (struct minst_ssa_val *)realloc(s->vals, s->val_cap * sizeof (s->vals[0]));
+        if (!s->vals)
+            vm_error("minst_ssa_val_new() realloc failure, %d", s->val_cap);
+    }
+
+    v = &s->vals[s->val_num];
+    v->kind = kind;
+    v->reg = reg;
+    v->kill_reg = kill_reg;
+    v->inst = inst;
+    v->prev = prev;
+    v->num = 0;
+
+    return s->val_num++;
+}
+
+void                minst_blk_ssa_uninit(struct minst_blk *blk)
+{
+    struct minst_ssa *s = &blk->ssa;
+
+    minst_df_graph_uninit(&s->g);
+    minst_df_edges_free(&s->df);
+
+    if (s->idom)            free(s->idom);
+    if (s->root)            free(s->root);
+    if (s->vals)            free(s->vals);
+    if (s->ops)             free(s->ops);
+    if (s->entry)           free(s->entry);
+    if (s->def_start)       free(s->def_start);
+    if (s->def_vals)        free(s->def_vals);
+    if (s->use_start)       free(s->use_start);
+    if (s->use_vals)        free(s->use_vals);
+    if (s->inst_pos)        free(s->inst_pos);
+    if (s->gen_reg)         free(s->gen_reg);
+    if (s->dmask)           free(s->dmask);
+    if (s->q.gen)           free(s->q.gen);
+    if (s->q.head)          free(s->q.head);
+    if (s->q.next)          free(s->q.next);
+    if (s->q.mask)          free(s->q.mask);
+    if (s->q.stack)         free(s->q.stack);
+    if (s->q.stack_mask)    free(s->q.stack_mask);
+    if (s->vn)              free(s->vn);
+    if (s->vn_const)        free(s->vn_const);
+
+    memset(s, 0, sizeof (s[0]));
+}
+
+/* 支配边界 */
+static void         minst_ssa_frontiers(struct minst_ssa *s)
+{
+    struct minst_df_graph *g = &s->g;
+    int *from, *to, *last, j, k, b, p, num = 0;
+
+    /* 虚拟根到每个DFS树根也有一条边，算进前驱数里。第一遍只数边数，第二遍填 */
+    last = minst_df_ints(g->num);
+    from = to = NULL;
+    for (k = 0; k < 2; k++) {
+        for (b = 0; b < g->num; b++) last[b] = -1;
+
+        for (b = 0, num = 0; b < g->num; b++) {
+            if ((g->preds.start[b + 1] - g->preds.start[b] + s->root[b]) < 2) continue;
+
+            for (j = g->preds.start[b]; j < g->preds.start[b + 1]; j++) {
+                for (p = g->preds.to[j]; (p >= 0) && (p != s->idom[b]); p = s->idom[p]) {
+                    if (last[p] == b) break;
+                    last[p] = b;
+                    if (from) {
+                        from[num] = p;
+                        to[num] = b;
+                    }
+                    num++;
+                }
+            }
+        }
+
+        if (!from) {
+            from = minst_df_ints(num);
+            to = minst_df_ints(num);
+        }
+    }
+
+    minst_df_edges_build(&s->df, g->num, from, to, num);
+
+    free(from);
+    free(to);
+    free(last);
+}
+
+static void         minst_ssa_number(struct minst_blk *blk);
+
+int                 minst_blk_ssa_build(struct minst_blk *blk)
+{
+    struct minst_ssa *s = &blk->ssa;
+    struct minst_df_graph *g = &s->g;
+    struct minst *minst;
+    struct minst_ssa_val *v;
+    uint64_t co[REGS_NUM], *aff, *blkaff, a;
+    int *rpo, *wl, *inwl, *phimark, *exitv, *cur, bits[64];
+    int i, j, k, n, b, r, x, id, top, num, nb;
+
+    minst_blk_ssa_uninit(blk);
+    minst_blk_du_invalidate(blk);
+
+    minst_df_graph_build(g, blk);
+    n = g->inst_num;
+
+    s->gen_reg = minst_df_ints(n);
+    s->dmask = (uint64_t *)calloc(n + 1, sizeof (s->dmask[0]));
+    aff = (uint64_t *)calloc(n + 1, sizeof (aff[0]));
+    blkaff = (uint64_t *)calloc(g->num + 1, sizeof (blkaff[0]));
+    if (!s->dmask || !aff || !blkaff)
+        vm_error("minst_blk_ssa_build() calloc failure");
+
+    /* 和 minst_blk_gen_reaching_definitions 里的快照规则一样 */
+    for (i = 0; i < n; i++) {
+        minst = blk->allinst.ptab[i];
+        if ((g->inst_blk[i] < 0) || minst->flag.epilogue)
+            s->gen_reg[i] = -2;
+        else
+            s->gen_reg[i] = (minst_get_def(minst) < 0) ? -1 : minst_get_def(minst);
+    }
+
+    for (r = 0; r < REGS_NUM; r++) {
+        for (i = 0; (nb = bitset_bits(&blk->defs[r], i, bits, 64)) > 0; i = bits[nb - 1] + 1) {
+            for (j = 0; (j < nb) && (bits[j] < n); j++)
+                s->dmask[bits[j]] |= 1ull << r;
+        }
+    }
+
+    /* co[r] 是和 r 被同一条指令定值过的寄存器 */
+    memset(co, 0, sizeof (co));
+    for (i = 0; i < n; i++) {
+        if (s->gen_reg[i] < 0) continue;
+        for (r = 0; r < REGS_NUM; r++) {
+            if ((s->dmask[i] >> r) & 1)
+                co[r] |= s->dmask[i];
+        }
+    }
+    for (r = 0; r < REGS_NUM; r++)
+        co[r] &= ~(1ull << r);
+
+    /* aff[i] 是指令i上会产生新值的寄存器 */
+    for (i = 0; i < n; i++) {
+        if ((x = s->gen_reg[i]) < 0) continue;
+
+        aff[i] = s->dmask[i];
+        if (x < REGS_NUM)
+            aff[i] |= (1ull << x) | co[x];
+        blkaff[g->inst_blk[i]] |= aff[i];
+    }
+
+    /* 支配树，DFS 沿着前驱边的反向边走，和前向数据流看到的图一致 */
+    rpo = minst_df_ints(g->num);
+    s->root = minst_df_ints(g->num);
+    minst_df_order(g->num, &g->preds_r, NULL, 0, rpo, s->root);
+    s->idom = minst_df_ints(g->num);
+    minst_dom_solve(g->num, &g->preds, rpo, g->num, s->root, s->idom);
+    minst_ssa_frontiers(s);
+
+    for (r = 0; r < REGS_NUM; r++)
+        minst_ssa_val_new(s, MINST_SSA_UNDEF, r, 0xff, -1, -1);
+
+    /* 插 phi */
+    s->entry = minst_df_ints(g->num * REGS_NUM);
+    for (i = 0; i < g->num * REGS_NUM; i++)
+        s->entry[i] = -1;
+
+    wl = minst_df_ints(g->num);
+    inwl = minst_df_ints(g->num);
+    phimark = minst_df_ints(g->num);
+    for (r = 0; r < REGS_NUM; r++) {
+        for (b = 0, top = -1; b < g->num; b++) {
+            if ((blkaff[b] >> r) & 1) {
+                wl[++top] = b;
+                inwl[b] = r + 1;
+            }
+        }
+
+        while (top >= 0) {
+            b = wl[top--];
+            for (j = s->df.start[b]; j < s->df.start[b + 1]; j++) {
+                k = s->df.to[j];
+                if (phimark[k] == r + 1) continue;
+
+                phimark[k] = r + 1;
+                s->entry[k * REGS_NUM + r] = minst_ssa_val_new(s, MINST_SSA_PHI, r, 0xff, k, -1);
+                if (inwl[k] != r + 1) {
+                    inwl[k] = r + 1;
+                    wl[++top] = k;
+                }
+            }
+        }
+    }
+
+    /* 按逆后序改名，块入口没有 phi 的寄存器取直接支配者出口的值 */
+    s->use_start = minst_df_ints(n + 1);
+    s->def_start = minst_df_ints(n + 1);
+    s->inst_pos = minst_df_ints(n);
+    for (i = 0; i < n; i++) {
+        minst = blk->allinst.ptab[i];
+        s->use_start[i + 1] = s->use_start[i];
+        s->def_start[i + 1] = s->def_start[i];
+        if (g->inst_blk[i] < 0) continue;
+
+        live_regs_foreach(&minst->use, r) {
+            if (r >= REGS_NUM) break;
+            s->use_start[i + 1]++;
+        }
+        for (a = aff[i]; a; a &= a - 1)
+            s->def_start[i + 1]++;
+    }
+    s->use_vals = minst_df_ints(s->use_start[n]);
+    s->def_vals = minst_df_ints(s->def_start[n]);
+
+    exitv = minst_df_ints(g->num * REGS_NUM);
+    for (i = 0; i < g->num; i++) {
+        b = rpo[i];
+        cur = s->entry + b * REGS_NUM;
+        for (r = 0; r < REGS_NUM; r++) {
+            if (cur[r] < 0)
+                cur[r] = s->root[b] ? r : exitv[s->idom[b] * REGS_NUM + r];
+        }
+        cur = exitv + b * REGS_NUM;
+        memcpy(cur, s->entry + b * REGS_NUM, REGS_NUM * sizeof (cur[0]));
+
+        for (j = g->inst_start[b]; j < g->inst_start[b + 1]; j++) {
+            id = g->insts[j];
+            minst = blk->allinst.ptab[id];
+            s->inst_pos[id] = j;
+
+            k = s->use_start[id];
+            live_regs_foreach(&minst->use, r) {
+                if (r >= REGS_NUM) break;
+                s->use_vals[k++] = cur[r];
+            }
+
+            if ((x = s->gen_reg[id]) < 0) continue;
+
+            k = s->def_start[id];
+            for (r = 0; r < REGS_NUM; r++) {
+                if (!((aff[id] >> r) & 1)) continue;
+
+                if (r == x)
+                    cur[r] = minst_ssa_val_new(s, MINST_SSA_DEF, r, 0xff, id, cur[r]);
+                else
+                    cur[r] = minst_ssa_val_new(s, ((s->dmask[id] >> r) & 1) ? MINST_SSA_MAYDEF : MINST_SSA_FILTER,
+                        r, (x < REGS_NUM) ? x : 0xff, id, cur[r]);
+                s->def_vals[k++] = cur[r];
+            }
+        }
+    }
+
+    /* phi 的参数按前驱边的顺序排，虚拟根来的是 UNDEF */
+    for (i = REGS_NUM, num = 0; i < s->val_num; i++) {
+        v = &s->vals[i];
+        if (v->kind != MINST_SSA_PHI) continue;
+        num += g->preds.start[v->inst + 1] - g->preds.start[v->inst] + s->root[v->inst];
+    }
+    s->ops = minst_df_ints(num);
+    for (i = REGS_NUM, num = 0; i < s->val_num; i++) {
+        v = &s->vals[i];
+        if (v->kind != MINST_SSA_PHI) continue;
+
+        v->prev = num;
+        for (j = g->preds.start[v->inst]; j < g->preds.start[v->inst + 1]; j++)
+            s->ops[num++] = exitv[g->preds.to[j] * REGS_NUM + v->reg];
+        if (s->root[v->inst])
+            s->ops[num++] = v->reg;
+        v->num = num - v->prev;
+    }
+
+    s->q.gen = minst_df_ints(s->val_num);
+    s->q.head = minst_df_ints(s->val_num);
+
+    free(aff);
+    free(blkaff);
+    free(rpo);
+    free(wl);
+    free(inwl);
+    free(phimark);
+    free(exitv);
+
+    minst_ssa_number(blk);
+    s->valid = 1;
+
+    return 0;
+}
+
+int                 minst_blk_ssa_update(struct minst_blk *blk)
+{
+    /* 值编号还取决于常量传播的结果，SSA 不用重建的时候也要重新编号 */
+    if (blk->ssa.valid) {
+        minst_ssa_number(blk);
+        return 0;
+    }
+
+    minst_blk_ssa_build(blk);
+
+    return 1;
+}
+
+/* 指令m入口处寄存器reg的值，-1 是查不到 */
+static int          minst_ssa_value(struct minst_ssa *s, struct minst *m, int reg)
+{
+    int i, j, b, id = m->id;
+
+    if ((reg < 0) || (reg >= REGS_NUM) || (id >= s->g.inst_num) || ((b = s->g.inst_blk[id]) < 0) || (s->gen_reg[id] == -2))
+        return -1;
+
+    for (j = s->use_start[id]; j < s->use_start[id + 1]; j++) {
+        if (s->vals[s->use_vals[j]].reg == reg)
+            return s->use_vals[j];
+    }
+
+    for (i = s->inst_pos[id] - 1; i >= s->g.inst_start[b]; i--) {
+        id = s->g.insts[i];
+        for (j = s->def_start[id]; j < s->def_start[id + 1]; j++) {
+            if (s->vals[s->def_vals[j]].reg == reg)
+                return s->def_vals[j];
+        }
+    }
+
+    return s->entry[b * REGS_NUM + reg];
+}
+
+/* 值编号的hash表，pool 里每项是 [next, vn, blk, len, key...]，head 是每个桶的第一项 */
+struct minst_vn_tab {
+    int     *head;
+    int     mask;
+    int     *pool;
+    int     num;
+    int     cap;
+};
+
+static unsigned     minst_vn_hash(int *key, int len)
+{
+    unsigned h = 2166136261u;
+    int i;
+
+    for (i = 0; i < len; i++)
+        h = (h ^ (unsigned)key[i]) * 16777619u;
+
+    return h;
+}
+
+/* 找一个和 key 一样、并且所在块支配块b的值，b < 0 时不看支配关系 */
+static int          minst_vn_find(struct minst_vn_tab *t, int *key, int len, int b, int *pre, int *post)
+{
+    int off, e;
+
+    for (off = t->head[minst_vn_hash(key, len) & t->mask]; off >= 0; off = t->pool[off]) {
+        if ((t->pool[off + 3] != len) || memcmp(t->pool + off + 4, key, len * sizeof (key[0])))
+            continue;
+
+        e = t->pool[off + 2];
+        if ((b < 0) || (e < 0) || minst_dom_contains(pre, post, e, b))
+            return t->pool[off + 1];
+    }
+
+    return -1;
+}
+
+static void         minst_vn_add(struct minst_vn_tab *t, int *key, int len, int b, int vn)
+{
+    unsigned h = minst_vn_hash(key, len) & t->mask;
+
+    if (t->num + len + 4 > t->cap) {
+        t->cap = (t->cap + len + 4) * 2;
+        t->pool = (int *)realloc(t->pool, t->cap * sizeof (t->pool[0]));
+        if (!t->pool)
+            vm_error("minst_vn_add() realloc failure, %d", t->cap);
+    }
+
+    t->pool[t->num] = t->head[h];
+    t->pool[t->num + 1] = vn;
+    t->pool[t->num + 2] = b;
+    t->pool[t->num + 3] = len;
+    memcpy(t->pool + t->num + 4, key, len * sizeof (key[0]));
+    t->head[h] = t->num;
+    t->num += len + 4;
+}
+
+#define MINST_VN_KEY_MAX        48
+
+/* 只有一个定值、不在IT块里、不读写PC的指令才参与值编号 */
+static int          minst_vn_simple(struct minst *m)
+{
+    int r, n = 0;
+
+    if (m->flag.in_it_block || m->flag.prologue || m->flag.epilogue || m->ctx.setflags)
+        return 0;
+
+    live_regs_foreach(&m->def, r) {
+        if ((r >= REGS_NUM) || (r == ARM_REG_PC) || (++n > 1)) return 0;
+    }
+    live_regs_foreach(&m->use, r) {
+        if ((r >= REGS_NUM) || (r == ARM_REG_PC)) return 0;
+    }
+
+    return n == 1;
+}
+
+/* 指令m的值的key，不能编号的返回0。只看 pure_do 认可的纯运算：模拟器算出是常量、并且
+use 的寄存器也都是可信常量的按值编号，全局共享；其他的按去掉寄存器字段的指令编码和操作数的
+值编号，认不出寄存器字段的按原始编码和 use 寄存器的值编号。
+ldr 之类的常量来自内存，模拟器的内存不一定是真的，不参与 */
+static int          minst_vn_key(struct minst_blk *blk, struct minst *m, int *key, int *global)
+{
+    struct minst_ssa *s = &blk->ssa;
+    unsigned char code[4];
+    int regs[MINST_FIELDS_MAX], j, n, v, len = 0;
+
+    *global = 0;
+    if ((m->type != mtype_null) || !minst_vn_simple(m) || !blk->pure_do || !blk->pure_do(m))
+        return 0;
+
+    if (m->flag.is_const) {
+        for (j = s->use_start[m->id]; j < s->use_start[m->id + 1]; j++) {
+            if (s->vn_const[s->vn[s->use_vals[j]]] < 0) break;
+        }
+
+        if (j == s->use_start[m->id + 1]) {
+            *global = 1;
+            key[len++] = 1;
+            key[len++] = m->ld_imm;
+            return len;
+        }
+    }
+
+    key[len++] = 2;
+    key[len++] = m->len;
+
+    /* 寄存器字段清零以后按字段顺序放操作数的值编号，只写不读的字段(目的寄存器)放-1，
+    这样只是目的寄存器不同的计算编号相同 */
+    if (blk->fields_do && (m->len <= 4) && ((n = blk->fields_do(m, code, regs)) > 0)) {
+        for (j = 0; j < m->len; j++)
+            key[len++] = code[j];
+
+        for (j = 0; j < n; j++) {
+            if ((regs[j] < 0) || !live_regs_get(&m->use, regs[j]))
+                key[len++] = -1;
+            else if (((v = minst_ssa_value(s, m, regs[j])) < 0) || (s->vn[v] < 0))
+                return 0;
+            else
+                key[len++] = s->vn[v];
+        }
+
+        return len;
+    }
+
+    for (j = 0; j < m->len; j++)
+        key[len++] = m->addr[j];
+
+    for (j = s->use_start[m->id]; j < s->use_start[m->id + 1]; j++) {
+        if (len + 2 > MINST_VN_KEY_MAX) return 0;
+        key[len++] = s->vals[s->use_vals[j]].reg;
+        key[len++] = s->vn[s->use_vals[j]];
+    }
+
+    return len;
+}
+
+/* 按逆后序给SSA值编号。phi 的参数要是都已经编过号并且相同就取这个号；复写取源操作数的号；
+可信的常量按值全局共享一个号；纯运算在支配树上找一样的计算。已经删掉的指令的定值取之前的值的号 */
+static void         minst_ssa_number(struct minst_blk *blk)
+{
+    struct minst_ssa *s = &blk->ssa;
+    struct minst_df_graph *g = &s->g;
+    struct minst_ssa_val *v;
+    struct minst_vn_tab t = {0};
+    struct minst *m;
+    int key[MINST_VN_KEY_MAX], *rpo, *pre, *post, i, j, k, b, r, id, val, len, global, vn, nvn = 0;
+
+    if (!s->vn) {
+        s->vn = minst_df_ints(s->val_num);
+        s->vn_const = minst_df_ints(s->val_num);
+    }
+    for (i = 0; i < s->val_num; i++)
+        s->vn[i] = s->vn_const[i] = -1;
+
+    for (t.mask = 1; t.mask < s->val_num; t.mask <<= 1);
+    t.head = minst_df_ints(t.mask);
+    for (i = 0; i < t.mask; i++) t.head[i] = -1;
+    t.mask--;
+
+    rpo = minst_df_ints(g->num);
+    pre = minst_df_ints(g->num);
+    post = minst_df_ints(g->num);
+    minst_df_order(g->num, &g->preds_r, NULL, 0, rpo, NULL);
+    minst_dom_number(g->num, s->idom, pre, post);
+
+    for (r = 0; r < REGS_NUM; r++)
+        s->vn[r] = nvn++;
+
+    for (i = 0; i < g->num; i++) {
+        b = rpo[i];
+
+        for (r = 0; r < REGS_NUM; r++) {
+            val = s->entry[b * REGS_NUM + r];
+            v = &s->vals[val];
+            if ((v->kind != MINST_SSA_PHI) || (v->inst != b)) continue;
+
+            for (k = 0, vn = -1; k < v->num; k++) {
+                j = s->vn[s->ops[v->prev + k]];
+                if ((j < 0) || ((vn >= 0) && (j != vn))) break;
+                vn = j;
+            }
+            s->vn[val] = (k == v->num) ? vn : nvn++;
+        }
+
+        for (j = g->inst_start[b]; j < g->inst_start[b + 1]; j++) {
+            id = g->insts[j];
+            m = blk->allinst.ptab[id];
+
+            for (k = s->def_start[id]; k < s->def_start[id + 1]; k++) {
+                val = s->def_vals[k];
+                v = &s->vals[val];
+
+                if ((v->kind == MINST_SSA_FILTER) || m->flag.dead_code) {
+                    s->vn[val] = s->vn[v->prev];
+                    continue;
+                }
+                if (v->kind != MINST_SSA_DEF) {
+                    s->vn[val] = nvn++;
+                    continue;
+                }
+
+                if ((m->type == mtype_mov_reg) && minst_vn_simple(m)
+                    && ((s->use_start[id + 1] - s->use_start[id]) == 1)) {
+                    s->vn[val] = s->vn[s->use_vals[s->use_start[id]]];
+                    continue;
+                }
+
+                if (!(len = minst_vn_key(blk, m, key, &global))) {
+                    s->vn[val] = nvn++;
+                    continue;
+                }
+
+                if ((vn = minst_vn_find(&t, key, len, global ? -1 : b, pre, post)) < 0) {
+                    vn = nvn++;
+                    minst_vn_add(&t, key, len, global ? -1 : b, vn);
+                    if (global)
+                        s->vn_const[vn] = id;
+                }
+                s->vn[val] = vn;
+            }
+        }
+    }
+
+    free(t.head);
+    free(t.pool);
+    free(rpo);
+    free(pre);
+    free(post);
+}
+
+/* 指令m入口处reg的值编号是常量的，返回一条对应的常量指令 */
+static struct minst*    minst_ssa_const(struct minst_blk *blk, struct minst *m, int reg)
+{
+    struct minst_ssa *s = &blk->ssa;
+    struct minst *cm;
+    int v, c;
+
+    if (!s->vn || ((v = minst_ssa_value(s, m, reg)) < 0) || ((c = s->vn_const[s->vn[v]]) < 0))
+        return NULL;
+
+    cm = blk->allinst.ptab[c];
+    return cm->flag.is_const ? cm : NULL;
+}
+
+/* 全局值编号。寄存器里已经是同一个值的时候，再算一遍这个值的指令是多余的，直接删掉 */
+int                 minst_blk_value_numbering(struct minst_blk *blk)
+{
+    struct minst_ssa *s = &blk->ssa;
+    struct minst_ssa_val *v;
+    struct minst *m;
+    int i, k, changed = 0;
+
+    if (!s->vn) return 0;
+
+    for (i = 0; i < s->g.inst_num; i++) {
+        m = blk->allinst.ptab[i];
+        if ((s->gen_reg[i] < 0) || minst_is_dead_code(m)) continue;
+        if ((m->type != mtype_null) && (m->type != mtype_mov_reg)) continue;
+        if (!minst_vn_simple(m) || (minst_succs_count(m) > 1) || !blk->pure_do || !blk->pure_do(m)) continue;
+
+        for (k = s->def_start[i]; k < s->def_start[i + 1]; k++) {
+            v = &s->vals[s->def_vals[k]];
+            if (v->kind == MINST_SSA_DEF) break;
+        }
+        if (k == s->def_start[i + 1]) continue;
+
+        if (s->vn[s->def_vals[k]] != s->vn[v->prev]) continue;
+
+        minst_del_from_cfg(m);
+        changed = 1;
+    }
+
+    if (changed)
+        minst_blk_liveness_update(blk);
+
+    return changed;
+}
+
+/* 值v在过滤掩码f下访问过没有，f 越大能找到的定值越少，所以已经用 f 的子集访问过就不用再走 */
+static int          minst_ssa_seen(struct minst_ssa *s, int v, uint64_t f)
+{
+    int i;
+
+    if (s->q.gen[v] != s->q.cur) {
+        s->q.gen[v] = s->q.cur;
+        s->q.head[v] = -1;
+    }
+
+    for (i = s->q.head[v]; i >= 0; i = s->q.next[i]) {
+        if ((s->q.mask[i] & f) == s->q.mask[i])
+            return 1;
+    }
+
+    if (s->q.num == s->q.cap) {
+        s->q.cap = s->q.cap ? (s->q.cap * 2) : 256;
+        s->q.next = (int *)realloc(s->q.next, s->q.cap * sizeof (s->q.next[0]));
+        s->q.mask = (uint64_t *)realloc(s->q.mask, s->q.cap * sizeof (s->q.mask[0]));
+        if (!s->q.next || !s->q.mask)
+            vm_error("minst_ssa_seen() realloc failure, %d", s->q.cap);
+    }
+
+    s->q.mask[s->q.num] = f;
+    s->q.next[s->q.num] = s->q.head[v];
+    s->q.head[v] = s->q.num++;
+
+    return 0;
+}
+
+static void         minst_ssa_push(struct minst_ssa *s, int *top, int v, uint64_t f)
+{
+    if (*top + 1 == s->q.stack_cap) {
+        s->q.stack_cap = s->q.stack_cap ? (s->q.stack_cap * 2) : 256;
+        s->q.stack = (int *)realloc(s->q.stack, s->q.stack_cap * sizeof (s->q.stack[0]));
+        s->q.stack_mask = (uint64_t *)realloc(s->q.stack_mask, s->q.stack_cap * sizeof (s->q.stack_mask[0]));
+        if (!s->q.stack || !s->q.stack_mask)
+            vm_error("minst_ssa_push() realloc failure, %d", s->q.stack_cap);
+    }
+
+    ++*top;
+    s->q.stack[*top] = v;
+    s->q.stack_mask[*top] = f;
+}
+
+/* 从指令m入口处reg的值出发沿着SSA往回展开。删掉了的指令上的值当成不存在，直接看它之前的值，
+它的 kill 也不算 */
+static int          minst_ssa_reaching_defs(struct minst_blk *blk, struct minst *m, int reg, struct bitset *defs)
+{
+    struct minst_ssa *s = &blk->ssa;
+    struct minst_ssa_val *val;
+    int v, i, p, top = -1, count = 0;
+    uint64_t f;
+
+    bitset_clear(defs);
+    bitset_expand(defs, s->g.inst_num);
+
+    if ((v = minst_ssa_value(s, m, reg)) < 0)
+        return 0;
+
+    s->q.cur++;
+    s->q.num = 0;
+    minst_ssa_push(s, &top, v, 0);
+
+    while (top >= 0) {
+        v = s->q.stack[top];
+        f = s->q.stack_mask[top--];
+        if (minst_ssa_seen(s, v, f)) continue;
+
+        val = &s->vals[v];
+        if ((val->kind >= MINST_SSA_DEF) && (val->kind <= MINST_SSA_FILTER)
+            && ((struct minst *)blk->allinst.ptab[val->inst])->flag.dead_code) {
+            minst_ssa_push(s, &top, val->prev, f);
+            continue;
+        }
+
+        switch (val->kind) {
+        case MINST_SSA_DEF:
+        case MINST_SSA_MAYDEF:
+            p = val->inst;
+            if (((s->dmask[p] >> reg) & 1) && !(s->dmask[p] & f) && !bitset_get(defs, p)) {
+                bitset_set(defs, p, 1);
+                count++;
+            }
+            if (val->kind == MINST_SSA_DEF) break;
+            /* fall through */
+
+        case MINST_SSA_FILTER:
+            minst_ssa_push(s, &top, val->prev, f | ((val->kill_reg < REGS_NUM) ? (1ull << val->kill_reg) : 0));
+            break;
+
+        case MINST_SSA_PHI:
+            for (i = 0; i < val->num; i++)
+                minst_ssa_push(s, &top, s->ops[val->prev + i], f);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    return count;
+}
+
+int                 minst_get_reaching_defs(struct minst_blk *blk, struct minst *m, int reg, struct bitset *defs)
+{
+    struct minst_du *du = &blk->du;
+    int e, count = 0;
+
+    /* m 上 use 了 reg 的，直接从 use-def 链上取 */
+    if (!du->valid && blk->ssa.use_start)
+        minst_blk_du(blk);
+
+    if (du->valid && (m->id < du->num) && (reg >= 0) && (reg < REGS_NUM) && ((du->regs[m->id] >> reg) & 1)) {
+        bitset_clear(defs);
+        bitset_expand(defs, blk->ssa.g.inst_num);
+
+        minst_du_defs_foreach(du, m, e) {
+            if (du->edges[e].reg != reg) continue;
+            bitset_set(defs, du->edges[e].def, 1);
+            count++;
+        }
+        return count;
+    }
+
+    return minst_ssa_reaching_defs(blk, m, reg, defs);
+}
+
+struct bitset*      minst_blk_scratch_get(struct minst_blk *blk)
+{
+    struct bitset *bs;
+
+    if (blk->scratch.top == blk->scratch.num) {
+        blk->scratch.sets = (struct bitset **)realloc(blk->scratch.sets, (blk->scratch.num + 1) * sizeof (blk->scratch.sets[0]));
+        if (!blk->scratch.sets)
+            vm_error("minst_blk_scratch_get() realloc failure, %d", blk->scratch.num);
+
+        blk->scratch.sets[blk->scratch.num++] = (struct bitset *)marena_alloc(&blk->arena, sizeof (struct bitset));
+    }
+
+    bs = blk->scratch.sets[blk->scratch.top++];
+    bitset_expand(bs, blk->allinst.len);
+    bitset_clear(bs);
+
+    return bs;
+}
+
+void                minst_blk_scratch_put(struct minst_blk *blk, struct bitset *bs)
+{
+    if (!blk->scratch.top || (blk->scratch.sets[blk->scratch.top - 1] != bs))
+        vm_error("minst_blk_scratch_put() not the last scratch set, top:%d", blk->scratch.top);
+
+    blk->scratch.top--;
+}
+
+void                minst_blk_du_uninit(struct minst_blk *blk)
+{
+    struct minst_du *du = &blk->du;
+
+    if (du->uses_head)  free(du->uses_head);
+    if (du->defs_head)  free(du->defs_head);
+    if (du->regs)       free(du->regs);
+    if (du->edges)      free(du->edges);
+
+    memset(du, 0, sizeof (du[0]));
+}
+
+/* 定值的使用者链表按使用指令id从小到大排，使用指令的定值链表不排，新边挂在头上 */
+static int          minst_du_add(struct minst_du *du, int def, int use, int reg)
+{
+    struct minst_du_edge *e;
+    int k = du->edge_num, p = -1, x;
+
+    if (du->edge_num == du->edge_cap) {
+        du->edge_cap = du->edge_cap ? (du->edge_cap * 2) : 1024;
+        du->edges = (struct minst_du_edge *)realloc(du->edges, du->edge_cap * sizeof (du->edges[0]));
+        if (!du->edges)
+            vm_error("minst_du_add() realloc failure, %d", du->edge_cap);
+    }
+
+    e = &du->edges[k];
+    e->def = def;
+    e->use = use;
+    e->reg = reg;
+
+    /* 倒着建的时候头上的使用者id都比它大，不用往后找 */
+    for (x = du->uses_head[def]; (x >= 0) && (du->edges[x].use < use); x = du->edges[x].next_use)
+        p = x;
+
+    e->prev_use = p;
+    e->next_use = x;
+    if (x >= 0)
+        du->edges[x].prev_use = k;
+    if (p >= 0)
+        du->edges[p].next_use = k;
+    else
+        du->uses_head[def] = k;
+
+    e->prev_def = -1;
+    e->next_def = du->defs_head[use];
+    if (e->next_def >= 0)
+        du->edges[e->next_def].prev_def = k;
+    du->defs_head[use] = k;
+
+    return du->edge_num++;
+}
+
+static void         minst_du_unlink(struct minst_du *du, int k)
+{
+    struct minst_du_edge *e = &du->edges[k];
+
+    if (e->prev_use >= 0)   du->edges[e->prev_use].next_use = e->next_use;
+    else                    du->uses_head[e->def] = e->next_use;
+    if (e->next_use >= 0)   du->edges[e->next_use].prev_use = e->prev_use;
+
+    if (e->prev_def >= 0)   du->edges[e->prev_def].next_def = e->next_def;
+    else                    du->defs_head[e->use] = e->next_def;
+    if (e->next_def >= 0)   du->edges[e->next_def].prev_def = e->prev_def;
+
+    e->reg = -1;
+}
+
+struct minst_du*    minst_blk_du(struct minst_blk *blk)
+{
+    struct minst_du *du = &blk->du;
+    struct minst_ssa *s = &blk->ssa;
+    struct bitset *defs;
+    int i, j, k, r, x, n = s->g.inst_num, nb, bits[64];
+
+    if (du->valid) return du;
+
+    if (n > du->cap) {
+        du->cap = n;
+        du->uses_head = (int *)realloc(du->uses_head, n * sizeof (du->uses_head[0]));
+        du->defs_head = (int *)realloc(du->defs_head, n * sizeof (du->defs_head[0]));
+        du->regs = (uint64_t *)realloc(du->regs, n * sizeof (du->regs[0]));
+        if (!du->uses_head || !du->defs_head || !du->regs)
+            vm_error("minst_blk_du() realloc failure, %d", n);
+    }
+
+    du->num = n;
+    du->edge_num = 0;
+    for (i = 0; i < n; i++) {
+        du->uses_head[i] = du->defs_head[i] = -1;
+        du->regs[i] = 0;
+    }
+
+    /* 使用指令倒着建，挂在链表头上以后，定值指令的使用者链表是按指令id从小到大排的 */
+    defs = minst_blk_scratch_get(blk);
+    for (i = n - 1; i >= 0; i--) {
+        if (((struct minst *)blk->allinst.ptab[i])->flag.dead_code) continue;
+
+        for (j = s->use_start[i]; j < s->use_start[i + 1]; j++) {
+            r = s->vals[s->use_vals[j]].reg;
+            if ((du->regs[i] >> r) & 1) continue;
+            du->regs[i] |= 1ull << r;
+
+            minst_ssa_reaching_defs(blk, blk->allinst.ptab[i], r, defs);
+            for (k = 0; (nb = bitset_bits(defs, k, bits, 64)) > 0; k = bits[nb - 1] + 1) {
+                for (x = 0; x < nb; x++)
+                    minst_du_add(du, bits[x], i, r);
+            }
+        }
+    }
+    minst_blk_scratch_put(blk, defs);
+
+    du->valid = 1;
+
+    return du;
+}
+
+/* m 被删掉了(已经打上 dead_code)，m 的使用者沿着SSA重新找到达定值，m 的定值这时是透明的。
+m 上有过滤的值时，经过它的使用者不在 m 的链上，只能整个重建 */
+static void         minst_du_del(struct minst *m)
+{
+    struct minst_blk *blk = m->blk;
+    struct minst_ssa *s = &blk->ssa;
+    struct minst_du *du = &blk->du;
+    struct bitset *defs;
+    int e, k, d, u, r;
+
+    if (!du->valid || (m->id >= du->num))
+        return;
+
+    for (k = s->def_start[m->id]; k < s->def_start[m->id + 1]; k++) {
+        if (s->vals[s->def_vals[k]].kind == MINST_SSA_FILTER) {
+            minst_blk_du_invalidate(blk);
+            return;
+        }
+    }
+
+    defs = minst_blk_scratch_get(blk);
+    minst_du_uses_foreach(du, m, e) {
+        if ((r = du->edges[e].reg) < 0) continue;
+        u = du->edges[e].use;
+        minst_du_unlink(du, e);
+        if (u == m->id) continue;
+
+        /* u 在 r 上原来的边拆掉重连 */
+        for (k = du->defs_head[u]; k >= 0; k = du->edges[k].next_def) {
+            if (du->edges[k].reg == r)
+                minst_du_unlink(du, k);
+        }
+
+        minst_ssa_reaching_defs(blk, blk->allinst.ptab[u], r, defs);
+        bitset_foreach(defs, d)
+            minst_du_add(du, d, u, r);
+    }
+
+    minst_du_defs_foreach(du, m, e) {
+        if (du->edges[e].reg >= 0)
+            minst_du_unlink(du, e);
+    }
+    du->regs[m->id] = 0;
+    minst_blk_scratch_put(blk, defs);
+}
+
+void                minst_blk_dom_uninit(struct minst_blk *blk)
+{
+    struct minst_dom *d = &blk->dom;
+
+    minst_df_edges_free(&d->succs);
+    minst_df_edges_free(&d->preds);
+
+    if (d->rpo)             free(d->rpo);
+    if (d->idom)            free(d->idom);
+    if (d->ipdom)           free(d->ipdom);
+    if (d->pre)             free(d->pre);
+    if (d->post)            free(d->post);
+    if (d->ppre)            free(d->ppre);
+    if (d->ppost)           free(d->ppost);
+    if (d->loop_header)     free(d->loop_header);
+    if (d->loop_parent)     free(d->loop_parent);
+    if (d->loop_depth)      free(d->loop_depth);
+    if (d->latches)         free(d->latches);
+
+    memset(d, 0, sizeof (d[0]));
+}
+
+/* 自然循环：回边 u->h 要求 h 支配 u。按逆后序倒着处理循环头，内层循环先建好，
+外层循环碰到内层循环的节点时直接跳到内层循环最外面的头上 */
+static void         minst_dom_loops(struct minst_dom *d)
+{
+    int *stack, i, j, b, h, t, top;
+
+    stack = minst_df_ints(d->preds.start[d->num] + d->num);
+
+    for (b = 0; b < d->num; b++)
+        d->loop_header[b] = d->loop_parent[b] = -1;
+
+    for (i = d->rpo_num - 1; i >= 0; i--) {
+        h = d->rpo[i];
+        top = -1;
+
+        for (j = d->preds.start[h]; j < d->preds.start[h + 1]; j++) {
+            b = d->preds.to[j];
+            if (!minst_dom_contains(d->pre, d->post, h, b)) continue;
+            d->latches[h]++;
+            stack[++top] = b;
+        }
+        if (!d->latches[h]) continue;
+
+        d->loop_header[h] = h;
+        while (top >= 0) {
+            b = stack[top--];
+            if (b == h) continue;
+
+            if (d->loop_header[b] < 0) {
+                d->loop_header[b] = h;
+            }
+            else {
+                for (t = d->loop_header[b]; d->loop_parent[t] >= 0; t = d->loop_parent[t]);
+                if (t == h) continue;
+                d->loop_parent[t] = h;
+                b = t;
+            }
+
+            for (j = d->preds.start[b]; j < d->preds.start[b + 1]; j++) {
+                if (d->idom[d->preds.to[j]] != -2)
+                    stack[++top] = d->preds.to[j];
+            }
+        }
+    }
+
+    /* 外层循环头支配内层的，逆后序里在前面 */
+    for (i = 0; i < d->rpo_num; i++) {
+        b = d->rpo[i];
+        h = d->loop_header[b];
+        if (h == b)
+            d->loop_depth[b] = ((d->loop_parent[b] >= 0) ? d->loop_depth[d->loop_parent[b]] : 0) + 1;
+        else if (h >= 0)
+            d->loop_depth[b] = d->loop_depth[h];
+    }
+
+    free(stack);
+}
+
+struct minst_dom*   minst_blk_dom(struct minst_blk *blk)
+{
+    struct minst_dom *d = &blk->dom;
+    struct minst_cfg *cfg, *tcfg;
+    struct minst_node *node;
+    struct minst *m;
+    int *from, *to, *root, *exits, *prpo, i, n, num, nexit, entry = 0;
+
+    if (d->valid)
+        return d;
+
+    minst_blk_dom_uninit(blk);
+    n = d->num = blk->allcfg.len;
+
+    for (i = 0, num = 0; i < n; i++) {
+        cfg = blk->allcfg.ptab[i];
+        if (cfg->flag.dead_code || !cfg->end) continue;
+        minst_succs_foreach(cfg->end, node) {
+            if (node->minst && (tcfg = node->minst->cfg) && !tcfg->flag.dead_code)
+                num++;
+        }
+    }
+
+    from = minst_df_ints(num);
+    to = minst_df_ints(num);
+    for (i = 0, num = 0; i < n; i++) {
+        cfg = blk->allcfg.ptab[i];
+        if (cfg->flag.dead_code || !cfg->end) continue;
+        minst_succs_foreach(cfg->end, node) {
+            if (!node->minst || !(tcfg = node->minst->cfg) || tcfg->flag.dead_code) continue;
+            from[num] = i;
+            to[num++] = tcfg->id;
+        }
+    }
+    minst_df_edges_build(&d->succs, n, from, to, num);
+    minst_df_edges_build(&d->preds, n, to, from, num);
+    free(from);
+    free(to);
+
+    d->rpo = minst_df_ints(n);
+    d->idom = minst_df_ints(n);
+    d->ipdom = minst_df_ints(n);
+    d->pre = minst_df_ints(n);
+    d->post = minst_df_ints(n);
+    d->ppre = minst_df_ints(n);
+    d->ppost = minst_df_ints(n);
+    d->loop_header = minst_df_ints(n);
+    d->loop_parent = minst_df_ints(n);
+    d->loop_depth = minst_df_ints(n);
+    d->latches = minst_df_ints(n);
+    root = minst_df_ints(n);
+
+    /* 支配树，从入口出发 */
+    if (n && !((struct minst_cfg *)blk->allcfg.ptab[0])->flag.dead_code) {
+        root[0] = 1;
+        d->rpo_num = minst_df_order(n, &d->succs, &entry, 1, d->rpo, NULL);
+    }
+    minst_dom_solve(n, &d->preds, d->rpo, d->rpo_num, root, d->idom);
+    minst_dom_number(n, d->idom, d->pre, d->post);
+
+    /* 后支配树，在反向图上从所有出口出发 */
+    exits = minst_df_ints(n);
+    prpo = minst_df_ints(n);
+    memset(root, 0, n * sizeof (root[0]));
+    nexit = 0;
+    bitset_foreach(&blk->funcends, i) {
+        m = blk->allinst.ptab[i];
+        if (!m->cfg || m->cfg->flag.dead_code || root[m->cfg->id]) continue;
+        root[m->cfg->id] = 1;
+        exits[nexit++] = m->cfg->id;
+    }
+    num = minst_df_order(n, &d->preds, exits, nexit, prpo, NULL);
+    minst_dom_solve(n, &d->succs, prpo, num, root, d->ipdom);
+    minst_dom_number(n, d->ipdom, d->ppre, d->ppost);
+
+    minst_dom_loops(d);
+
+    free(root);
+    free(exits);
+    free(prpo);
+
+    d->valid = 1;
+
+    return d;
+}
+
+int                 minst_cfg_dominates(struct minst_cfg *a, struct minst_cfg *b)
+{
+    struct minst_dom *d = minst_blk_dom(a->blk);
+
+    return minst_dom_contains(d->pre, d->post, a->id, b->id);
+}
+
+int                 minst_cfg_postdominates(struct minst_cfg *a, struct minst_cfg *b)
+{
+    struct minst_dom *d = minst_blk_dom(a->blk);
+
+    return minst_dom_contains(d->ppre, d->ppost, a->id, b->id);
+}
+
+int                 minst_cfg_is_reachable(struct minst_cfg *cfg)
+{
+    return minst_blk_dom(cfg->blk)->idom[cfg->id] != -2;
+}
+
+struct minst_cfg*   minst_cfg_loop_header(struct minst_cfg *cfg)
+{
+    int h = minst_blk_dom(cfg->blk)->loop_header[cfg->id];
+
+    return (h < 0) ? NULL : cfg->blk->allcfg.ptab[h];
+}
+
+int                 minst_cfg_loop_depth(struct minst_cfg *cfg)
+{
+    return minst_blk_dom(cfg->blk)->loop_depth[cfg->id];
+}
+
+int                 minst_blk_copy_propagation(struct minst_blk *blk)
+{
+    int i, use, changed = 1, ret = 0;
+    struct minst *m, *def_m;
+    struct bitset *defs = minst_blk_scratch_get(blk);
+
+    while (changed) {
+        changed = 0;
+        for (i = 0; i < blk->allinst.len; i++) {
+            m = blk->allinst.ptab[i];
+            if ((m->type == mtype_mov_reg) || (m->type == mtype_ldr)) {
+                use = minst_get_use(m);
+                minst_get_reaching_defs(blk, m, use, defs);
+
+                if ((bitset_count(defs) == 1)) {
+                    def_m = blk->allinst.ptab[bitset_1th(defs)];
+                    if (m->preds.minst != def_m) continue;
+                    /* def_m 这一轮已经被删了，m 的到达定值变了，留到下一轮再看 */
+                    if (def_m->flag.dead_code) continue;
+
+                    if ((m->type == mtype_mov_reg) && (def_m->type == mtype_mov_reg)
+                        && (minst_get_def(m) == minst_get_use(def_m)) && (minst_get_use(m) == minst_get_def(def_m))) {
+                        minst_del_from_cfg(m);
+                        ret = changed = 1;
+                        continue;
+                    }
+
+                    if ((m->type == mtype_ldr) && (def_m->type == mtype_str)
+                        && (minst_get_def(m) == minst_get_use(def_m)) && (minst_get_use(m) == minst_get_def(def_m))) {
+                        minst_del_from_cfg(m);
+                        ret = changed = 1;
+                        continue;
+                    }
+                }
+            }
+        }
+
+        /* 一轮里删掉的指令互不影响，删完以后只重算受影响的块 */
+        if (changed)
+            minst_blk_liveness_update(blk);
+    }
+
+    minst_blk_scratch_put(blk, defs);
+    return ret;
+}
+
+/* mov 合并只在 r0-r12 里挑，sp/lr/pc 和 APSR 不动 */
+#define MINST_RA_REGS           13
+/* bl 的活跃信息只把 r0-r1 记成了 def，按调用约定 r2,r3,r12 也会被破坏 */
+#define MINST_RA_CALL_CLOBBER   ((1 << ARM_REG_R0) | (1 << ARM_REG_R1) | (1 << ARM_REG_R2) | (1 << ARM_REG_R3) | (1 << ARM_REG_R12))
+
+struct minst_ra {
+    struct minst_blk    *blk;
+    int         inst_num;
+    /* 线性化以后的指令，下标k的指令 use 在 2k，def 在 2k+1 */
+    int         *order;
+    int         num;
+    /* site[id * MINST_RA_REGS + r] 是指令id对寄存器r的定值在并查集里的节点，-1 还没建 */
+    int         *site;
+    int         *parent;
+    int         *node_inst;
+    int         node_num;
+    /* ref[id * MINST_RA_REGS + r] 是指令id上读写寄存器r的那个节点 */
+    int         *ref;
+    /* 以下按并查集的根存：活跃区间、原来的寄存器、分到的寄存器、是否固定、能分到的寄存器掩码 */
+    int         *start;
+    int         *end;
+    int         *orig;
+    int         *reg;
+    int         *fixed;
+    int         *allow;
+    /* 函数入口处各个寄存器的值 */
+    int         entry[MINST_RA_REGS];
+    /* 这些寄存器上有查不到值的使用，不能分给别人，原来在上面的也不能动 */
+    int         blocked;
+    /* 往回找定值时用的栈和访问标记 */
+    int         *stack;
+    int         *seen;
+    int         stamp;
+    /* 合并时每个寄存器上的web：plist[pstart[p]..pstart[p+1]) 是一开始在p上的web，按区间起点
+    排好，pcur[p] 以前的已经扫过；扫过了还没结束的挂在 active[p] 链表上。挪走了的web不从
+    原来的表里删，用到的时候看 reg 对不对 */
+    int         *plist;
+    int         pstart[MINST_RA_REGS + 1];
+    int         pcur[MINST_RA_REGS];
+    int         active[MINST_RA_REGS];
+    int         *anext;
+};
+
+static int          minst_ra_find(struct minst_ra *ra, int n)
+{
+    while (ra->parent[n] != n) {
+        ra->parent[n] = ra->parent[ra->parent[n]];
+        n = ra->parent[n];
+    }
+
+    return n;
+}
+
+static int          minst_ra_union(struct minst_ra *ra, int a, int b)
+{
+    a = minst_ra_find(ra, a);
+    b = minst_ra_find(ra, b);
+    if (a != b)
+        ra->parent[b] = a;
+
+    return a;
+}
+
+static int          minst_ra_node(struct minst_ra *ra, int id, int r)
+{
+    int n = ra->node_num++;
+
+    ra->parent[n] = n;
+    ra->node_inst[n] = id;
+    ra->start[n] = 0x7fffffff;
+    ra->end[n] = -1;
+    ra->orig[n] = r;
+
+    return n;
+}
+
+static int          minst_ra_site(struct minst_ra *ra, int id, int r)
+{
+    int *s = &ra->site[id * MINST_RA_REGS + r];
+
+    if (*s < 0)
+        *s = minst_ra_node(ra, id, r);
+
+    return *s;
+}
+
+/* 沿着SSA值往回找指令m入口处r的值是哪些定值流过来的，全部连成一个web，返回其中一个节点。
+从函数入口流过来的(UNDEF)连到r的入口节点上，入口节点是固定的 */
+static int          minst_ra_reach(struct minst_ra *ra, struct minst *m, int r)
+{
+    struct minst_ssa *s = &ra->blk->ssa;
+    struct minst_ssa_val *v;
+    int top = 0, x, i, n = -1, u;
+
+    if ((x = minst_ssa_value(s, m, r)) < 0) {
+        ra->blocked |= 1 << r;
+        return -1;
+    }
+
+    ra->stamp++;
+    ra->stack[top++] = x;
+    while (top > 0) {
+        x = ra->stack[--top];
+        if (ra->seen[x] == ra->stamp) continue;
+        ra->seen[x] = ra->stamp;
+
+        v = &s->vals[x];
+        u = -1;
+
+        /* 已经删掉的指令的定值对后面透明 */
+        if ((v->kind >= MINST_SSA_DEF) && (v->kind <= MINST_SSA_FILTER)
+            && ((struct minst *)ra->blk->allinst.ptab[v->inst])->flag.dead_code) {
+            ra->stack[top++] = v->prev;
+            continue;
+        }
+
+        switch (v->kind) {
+        case MINST_SSA_UNDEF:
+            if (ra->entry[r] < 0)
+                ra->entry[r] = minst_ra_node(ra, -1, r);
+            u = ra->entry[r];
+            break;
+
+        /* MAYDEF 在到达定值里不 kill 之前的定值，这里也一起连上，多连只会更保守 */
+        case MINST_SSA_MAYDEF:
+            ra->stack[top++] = v->prev;
+        case MINST_SSA_DEF:
+            u = minst_ra_site(ra, v->inst, r);
+            break;
+
+        case MINST_SSA_FILTER:
+            ra->stack[top++] = v->prev;
+            break;
+
+        case MINST_SSA_PHI:
+            for (i = 0; i < v->num; i++)
+                ra->stack[top++] = s->ops[v->prev + i];
+            break;
+        }
+
+        if (u >= 0)
+            n = (n < 0) ? u : minst_ra_union(ra, n, u);
+    }
+
+    return n;
+}
+
+/* 区间先记在节点上，全部合并完以后再汇总到根 */
+static void         minst_ra_point(struct minst_ra *ra, int n, int pos)
+{
+    if (pos < ra->start[n]) ra->start[n] = pos;
+    if (pos > ra->end[n]) ra->end[n] = pos;
+}
+
+/* cfg 按逆后序排，cfg 内按指令顺序排，不可达的cfg放在最后 */
+static void         minst_ra_linearize(struct minst_ra *ra)
+{
+    struct minst_blk *blk = ra->blk;
+    struct minst_dom *d = minst_blk_dom(blk);
+    struct minst_cfg *cfg;
+    struct minst *m;
+    int i, *seen;
+
+    seen = minst_df_ints(blk->allcfg.len);
+    for (i = 0; i < d->rpo_num + blk->allcfg.len; i++) {
+        cfg = blk->allcfg.ptab[(i < d->rpo_num) ? d->rpo[i] : (i - d->rpo_num)];
+        if (cfg->flag.dead_code || seen[cfg->id]++ || !cfg->start) continue;
+
+        for (m = cfg->start; m; m = m->succs.minst) {
+            if (!minst_is_dead_code(m))
+                ra->order[ra->num++] = m->id;
+            if (m == cfg->end) break;
+        }
+    }
+    free(seen);
+}
+
+static void         minst_ra_build(struct minst_ra *ra)
+{
+    struct minst_blk *blk = ra->blk;
+    struct minst_node *node;
+    struct minst *m;
+    int k, r, n, u, id, cap, used = 0;
+
+    for (k = 0; k < ra->num; k++) {
+        id = ra->order[k];
+        m = blk->allinst.ptab[id];
+        cap = -1;
+
+        for (r = 0; r < MINST_RA_REGS; r++) {
+            int in = live_regs_get(&m->in, r), use = live_regs_get(&m->use, r),
+                def = live_regs_get(&m->def, r), out = live_regs_get(&m->out, r);
+
+            if (!in && !use && !def) continue;
+
+            if ((use || def) && (cap < 0))
+                cap = blk->rename_do ? blk->rename_do(m, NULL) : 0;
+
+            n = -1;
+            if (in || use) {
+                if ((n = minst_ra_reach(ra, m, r)) >= 0) {
+                    minst_ra_point(ra, n, 2 * k);
+                    if (out && !def)
+                        minst_ra_point(ra, n, 2 * k + 1);
+                }
+            }
+
+            if (def) {
+                used |= 1 << r;
+                u = minst_ra_site(ra, id, r);
+                minst_ra_point(ra, u, 2 * k + 1);
+                /* 同一个字段又读又写(movt，add rd, rm)，读的值和写的值只能在同一个寄存器 */
+                n = (use && (n >= 0)) ? minst_ra_union(ra, n, u) : u;
+            }
+            else if (!use) {
+                continue;
+            }
+
+            if (n < 0) continue;
+
+            ra->ref[id * MINST_RA_REGS + r] = n;
+            ra->allow[n] &= cap;
+        }
+
+        /* 调用会破坏的寄存器，当成一个固定的定值 */
+        if (m->type == mtype_bl) {
+            for (r = 0; r < MINST_RA_REGS; r++) {
+                if (!((MINST_RA_CALL_CLOBBER >> r) & 1)) continue;
+                u = minst_ra_site(ra, id, r);
+                minst_ra_point(ra, u, 2 * k + 1);
+                ra->fixed[u] = 1;
+            }
+        }
+
+        /* 流到 epilogue 的值要留在原来的寄存器上，r0-r1 是返回值，活跃信息里不一定有 r1 */
+        minst_succs_foreach(m, node) {
+            if (!node->minst || !node->minst->flag.epilogue) continue;
+
+            for (r = 0; r < MINST_RA_REGS; r++) {
+                if ((r > ARM_REG_R1) && !live_regs_get(&m->out, r)) continue;
+
+                if (live_regs_get(&m->def, r))
+                    ra->fixed[minst_ra_site(ra, id, r)] = 1;
+                else if ((n = minst_ra_reach(ra, m, r)) >= 0)
+                    ra->fixed[n] = 1;
+            }
+        }
+    }
+
+    /* 函数自己没改过的寄存器(比如没保存的 callee-saved)不能拿来用 */
+    ra->blocked |= ~(used | MINST_RA_CALL_CLOBBER) & ((1 << MINST_RA_REGS) - 1);
+
+    /* 汇总到根上 */
+    for (n = 0; n < ra->node_num; n++) {
+        r = minst_ra_find(ra, n);
+        if (r == n) continue;
+
+        if (ra->start[n] < ra->start[r]) ra->start[r] = ra->start[n];
+        if (ra->end[n] > ra->end[r]) ra->end[r] = ra->end[n];
+        ra->allow[r] &= ra->allow[n];
+        ra->fixed[r] |= ra->fixed[n];
+    }
+
+    for (n = 0; n < ra->node_num; n++) {
+        m = (ra->node_inst[n] < 0) ? NULL : blk->allinst.ptab[ra->node_inst[n]];
+        r = minst_ra_find(ra, n);
+        if (!m || m->flag.prologue || m->flag.epilogue || ((ra->blocked >> ra->orig[r]) & 1) || !ra->allow[r])
+            ra->fixed[r] = 1;
+        ra->reg[r] = ra->orig[r];
+    }
+}
+
+/* 寄存器p上起点不超过 pos 的web放进 active，active 里已经结束或者挪走了的去掉。
+pos 是按起点扫描的当前位置，只会往后走 */
+static void         minst_ra_advance(struct minst_ra *ra, int p, int pos)
+{
+    int x, *link;
+
+    while ((ra->pcur[p] < ra->pstart[p + 1]) && (ra->start[x = ra->plist[ra->pcur[p]]] <= pos)) {
+        ra->pcur[p]++;
+        if (ra->reg[x] != p) continue;
+
+        ra->anext[x] = ra->active[p];
+        ra->active[p] = x;
+    }
+
+    for (link = &ra->active[p]; (x = *link) >= 0; ) {
+        if ((ra->end[x] < pos) || (ra->reg[x] != p))
+            *link = ra->anext[x];
+        else
+            link = &ra->anext[x];
+    }
+}
+
+/* web w 能不能挪到寄存器p上：p上现有的web没有一个和w的区间重叠。
+w 的起点就是扫描的当前位置，active 里剩下的都盖住了这个位置，还没扫到的只要看起点最小的那个 */
+static int          minst_ra_free(struct minst_ra *ra, int w, int p)
+{
+    int x;
+
+    if (((ra->blocked >> p) & 1) || !((ra->allow[w] >> p) & 1))
+        return 0;
+
+    minst_ra_advance(ra, p, ra->start[w]);
+    if (ra->active[p] >= 0)
+        return 0;
+
+    while ((ra->pcur[p] < ra->pstart[p + 1]) && (ra->reg[ra->plist[ra->pcur[p]]] != p))
+        ra->pcur[p]++;
+    if (ra->pcur[p] == ra->pstart[p + 1])
+        return 1;
+
+    x = ra->plist[ra->pcur[p]];
+    return ra->start[x] > ra->end[w];
+}
+
+static int          minst_ra_start_cmp(const void *a, const void *b)
+{
+    const int *x = a, *y = b;
+
+    return x[0] - y[0];
+}
+
+/* 按区间起点扫描，每个能动的web尽量挪到和它有 mov 关系的web所在的寄存器上 */
+static int          minst_ra_coalesce(struct minst_ra *ra)
+{
+    struct minst_blk *blk = ra->blk;
+    struct minst *m;
+    int *hint, *hnext, *hhead, hnum = 0, *webs, wnum = 0, i, j, k, w, v, d, s, p, moved = 0;
+
+    hhead = minst_df_ints(ra->node_num);
+    hint = minst_df_ints(2 * ra->num);
+    hnext = minst_df_ints(2 * ra->num);
+    webs = minst_df_ints(2 * ra->node_num);
+    ra->plist = minst_df_ints(ra->node_num);
+    ra->anext = minst_df_ints(ra->node_num);
+    for (i = 0; i < ra->node_num; i++) hhead[i] = -1;
+
+    /* 所有的web按起点排好，再按所在的寄存器分桶，桶里还是按起点排的 */
+    for (i = 0; i < ra->node_num; i++) {
+        if (ra->parent[i] != i) continue;
+        webs[2 * wnum] = ra->start[i];
+        webs[2 * wnum + 1] = i;
+        wnum++;
+    }
+    qsort(webs, wnum, 2 * sizeof (webs[0]), minst_ra_start_cmp);
+
+    memset(ra->pstart, 0, sizeof (ra->pstart));
+    for (i = 0; i < wnum; i++)
+        ra->pstart[ra->reg[webs[2 * i + 1]] + 1]++;
+    for (p = 0; p < MINST_RA_REGS; p++) {
+        ra->pstart[p + 1] += ra->pstart[p];
+        ra->pcur[p] = ra->pstart[p];
+        ra->active[p] = -1;
+    }
+    for (i = 0; i < wnum; i++) {
+        w = webs[2 * i + 1];
+        ra->plist[ra->pcur[ra->reg[w]]++] = w;
+    }
+    for (p = 0; p < MINST_RA_REGS; p++)
+        ra->pcur[p] = ra->pstart[p];
+    wnum = 0;
+
+    for (k = 0; k < ra->num; k++) {
+        m = blk->allinst.ptab[ra->order[k]];
+        if (m->type != mtype_mov_reg) continue;
+        if (((d = minst_get_def(m)) < 0) || (d >= MINST_RA_REGS) || ((s = minst_get_use(m)) < 0) || (s >= MINST_RA_REGS))
+            continue;
+        if ((ra->ref[m->id * MINST_RA_REGS + d] < 0) || (ra->ref[m->id * MINST_RA_REGS + s] < 0))
+            continue;
+
+        d = minst_ra_find(ra, ra->ref[m->id * MINST_RA_REGS + d]);
+        s = minst_ra_find(ra, ra->ref[m->id * MINST_RA_REGS + s]);
+        if (d == s) continue;
+
+        hint[hnum] = s; hnext[hnum] = hhead[d]; hhead[d] = hnum++;
+        hint[hnum] = d; hnext[hnum] = hhead[s]; hhead[s] = hnum++;
+    }
+
+    for (i = 0; i < ra->node_num; i++) {
+        if ((ra->parent[i] != i) || ra->fixed[i] || (hhead[i] < 0)) continue;
+        webs[2 * wnum] = ra->start[i];
+        webs[2 * wnum + 1] = i;
+        wnum++;
+    }
+    qsort(webs, wnum, 2 * sizeof (webs[0]), minst_ra_start_cmp);
+
+    for (i = 0; i < wnum; i++) {
+        w = webs[2 * i + 1];
+        for (j = hhead[w]; j >= 0; j = hnext[j]) {
+            v = hint[j];
+            if ((ra->reg[v] == ra->reg[w]) || !minst_ra_free(ra, w, ra->reg[v])) continue;
+
+            p = ra->reg[w] = ra->reg[v];
+            ra->anext[w] = ra->active[p];
+            ra->active[p] = w;
+            moved = 1;
+            break;
+        }
+    }
+
+    free(hhead);
+    free(hint);
+    free(hnext);
+    free(webs);
+    free(ra->plist);
+    free(ra->anext);
+
+    return moved;
+}
+
+/* 把合并结果写回指令，活跃信息和 blk->defs/uses 跟着改 */
+static void         minst_ra_rewrite(struct minst_ra *ra)
+{
+    struct minst_blk *blk = ra->blk;
+    struct live_regs use, def;
+    struct minst *m;
+    int map[REGS_NUM], k, r, n, changed;
+
+    for (k = 0; k < ra->num; k++) {
+        m = blk->allinst.ptab[ra->order[k]];
+
+        for (r = 0; r < REGS_NUM; r++) map[r] = r;
+        for (r = 0, changed = 0; r < MINST_RA_REGS; r++) {
+            if ((n = ra->ref[m->id * MINST_RA_REGS + r]) < 0) continue;
+            n = minst_ra_find(ra, n);
+            map[r] = ra->reg[n];
+            changed |= (map[r] != r);
+        }
+        if (!changed) continue;
+
+        if (blk->rename_do(m, map))
+            vm_error("minst_ra_rewrite() minst[%d] rename failure", m->id);
+
+        use = m->use;
+        def = m->def;
+        for (r = 0; r < MINST_RA_REGS; r++) {
+            live_regs_set(&m->use, r, 0);
+            live_regs_set(&m->def, r, 0);
+            if (live_regs_get(&use, r))
+                bitset_set(&blk->uses[r], m->id, 0);
+            if (live_regs_get(&def, r))
+                bitset_set(&blk->defs[r], m->id, 0);
+        }
+        for (r = 0; r < MINST_RA_REGS; r++) {
+            if (live_regs_get(&use, r)) {
+                live_regs_set(&m->use, map[r], 1);
+                bitset_set(&blk->uses[map[r]], m->id, 1);
+            }
+            if (live_regs_get(&def, r)) {
+                live_regs_set(&m->def, map[r], 1);
+                bitset_set(&blk->defs[map[r]], m->id, 1);
+            }
+        }
+        m->ld = -2;
+    }
+
+    /* 定值的寄存器变了，SSA 要重建 */
+    minst_blk_ssa_invalidate(blk);
+}
+
+int                 minst_blk_coalesce(struct minst_blk *blk)
+{
+    struct minst_ra ra = {0};
+    struct minst *m;
+    int i, n, deleted = 0;
+
+    if (!blk->rename_do)
+        return 0;
+
+    minst_blk_liveness_calc(blk);
+    minst_blk_ssa_update(blk);
+
+    ra.blk = blk;
+    ra.inst_num = blk->allinst.len;
+    n = (ra.inst_num + 1) * MINST_RA_REGS;
+    ra.order = minst_df_ints(ra.inst_num);
+    ra.site = minst_df_ints(n);
+    ra.ref = minst_df_ints(n);
+    ra.parent = minst_df_ints(n);
+    ra.node_inst = minst_df_ints(n);
+    ra.start = minst_df_ints(n);
+    ra.end = minst_df_ints(n);
+    ra.orig = minst_df_ints(n);
+    ra.reg = minst_df_ints(n);
+    ra.fixed = minst_df_ints(n);
+    ra.allow = minst_df_ints(n);
+    for (i = 0; i < n; i++) {
+        ra.site[i] = ra.ref[i] = -1;
+        ra.allow[i] = -1;
+    }
+    for (i = 0; i < MINST_RA_REGS; i++)
+        ra.entry[i] = -1;
+    /* 每个值最多压一次 prev 或者全部 phi 参数 */
+    for (i = 0, n = blk->ssa.val_num; i < blk->ssa.val_num; i++) {
+        if (blk->ssa.vals[i].kind == MINST_SSA_PHI)
+            n += blk->ssa.vals[i].num;
+    }
+    ra.stack = minst_df_ints(n);
+    ra.seen = minst_df_ints(blk->ssa.val_num);
+
+    minst_ra_linearize(&ra);
+    minst_ra_build(&ra);
+
+    if (minst_ra_coalesce(&ra)) {
+        minst_ra_rewrite(&ra);
+
+        /* 两边分到同一个寄存器的 mov 就没用了 */
+        for (i = 0; i < ra.num; i++) {
+            m = blk->allinst.ptab[ra.order[i]];
+            if ((m->type == mtype_mov_reg) && (minst_get_def(m) == minst_get_use(m)) && (minst_succs_count(m) <= 1)) {
+                minst_del_from_cfg(m);
+                deleted++;
+            }
+        }
+
+        minst_blk_liveness_calc(blk);
+    }
+
+    free(ra.stack);
+    free(ra.seen);
+    free(ra.order);
+    free(ra.site);
+    free(ra.ref);
+    free(ra.parent);
+    free(ra.node_inst);
+    free(ra.start);
+    free(ra.end);
+    free(ra.orig);
+    free(ra.reg);
+    free(ra.fixed);
+    free(ra.allow);
+
+    return deleted;
+}
+
+/* 稀疏条件常量传播的格，TOP 是还没算到(没有定值的 UNDEF 也是 TOP)，值只会往下走 */
+enum {
+    MINST_SCCP_TOP,
+    MINST_SCCP_CONST,
+    MINST_SCCP_BOTTOM,
+};
+
+struct minst_sccp {
+    /* SSA值的格，是常量时 wit 是一条带着这个常量的指令 */
+    int         *lat;
+    int         *wit;
+    /* 同一个值按定值指令的 dmask 分开记的格，下标 值*cnum+类。FILTER 在到达定值里过滤掉的是
+    dmask 含 kill_reg 的定值，按类记就能整类丢掉，不用回头展开。cls 是指令的类，cmask 是类的 dmask */
+    int         *clat;
+    int         *cwit;
+    int         *cls;
+    uint64_t    *cmask;
+    int         cnum;
+    /* 指令的格，是常量时常量就在指令的 ld_imm/apsr 上；fixed 是进来时就是常量的，不再求值；
+    forced 是工作表空了还在等 TOP 操作数的，不再等，TOP 当成不知道 */
+    int         *state;
+    int         *fixed;
+    int         *forced;
+    /* 条件跳转已经能走的方向，bit0 是 false label，bit1 是 true label */
+    int         *dirs;
+    /* 可执行的块和前驱边(下标和 g.preds 一致)，entry 是入口块 */
+    int         *exec_blk;
+    int         *exec_edge;
+    int         *entry;
+    /* 值 -> 以它为 prev 或者 phi 参数的值 */
+    struct minst_df_edges   users;
+    /* 值 -> 求值时查过它的指令，求值过程中动态记下来 */
+    int         *dep_head;
+    int         *dep_next;
+    int         *dep_inst;
+    int         dep_num;
+    int         dep_cap;
+    /* 正在求值的指令，-1 是没有 */
+    int         cur;
+    /* 值、指令、块的工作表，in_v/in_i 标记在不在表里 */
+    int         *vwl, vtop, *in_v;
+    int         *iwl, itop, *in_i;
+    int         *bwl, btop;
+};
+
+static int          minst_sccp_same(struct minst *a, struct minst *b, int reg)
+{
+    if (a == b) return 1;
+
+    if (reg == ARM_REG_APSR)
+        return (a->apsr.n == b->apsr.n) && (a->apsr.z == b->apsr.z) && (a->apsr.c == b->apsr.c) && (a->apsr.v == b->apsr.v);
+
+    return a->ld_imm == b->ld_imm;
+}
+
+static void         minst_sccp_meet(struct minst_blk *blk, int reg, int *lat, int *wit, int l, int w)
+{
+    if ((l == MINST_SCCP_TOP) || (*lat == MINST_SCCP_BOTTOM))
+        return;
+
+    if (*lat == MINST_SCCP_TOP) {
+        *lat = l;
+        *wit = w;
+    }
+    else if ((l == MINST_SCCP_BOTTOM) || !minst_sccp_same(blk->allinst.ptab[*wit], blk->allinst.ptab[w], reg)) {
+        *lat = MINST_SCCP_BOTTOM;
+    }
+}
+
+/* 按指令的格和参数重新算值v每一类的格，再合成值的格，有一类变了就返回1 */
+static int          minst_sccp_val_eval(struct minst_blk *blk, int v)
+{
+    struct minst_sccp *sc = blk->sccp;
+    struct minst_ssa *s = &blk->ssa;
+    struct minst_df_graph *g = &s->g;
+    struct minst_ssa_val *val = &s->vals[v];
+    int *lat = sc->clat + v * sc->cnum, *wit = sc->cwit + v * sc->cnum;
+    int l, w, c, i, j, k, p = val->inst, changed = 0;
+    uint64_t f = (val->kill_reg < REGS_NUM) ? (1ull << val->kill_reg) : 0;
+
+    for (c = 0; c < sc->cnum; c++) {
+        l = MINST_SCCP_TOP;
+        w = -1;
+
+        switch (val->kind) {
+        /* 没有定值的路径和到达定值一样不算数 */
+        case MINST_SSA_UNDEF:
+            break;
+
+        /* 删掉了的指令对后面透明；MAYDEF/FILTER 之前的值要丢掉 dmask 含 kill_reg 的类 */
+        case MINST_SSA_DEF:
+        case MINST_SSA_MAYDEF:
+        case MINST_SSA_FILTER:
+            if (((struct minst *)blk->allinst.ptab[p])->flag.dead_code) {
+                l = sc->clat[val->prev * sc->cnum + c];
+                w = sc->cwit[val->prev * sc->cnum + c];
+                break;
+            }
+            if ((val->kind != MINST_SSA_FILTER) && (sc->cls[p] == c) && ((s->dmask[p] >> val->reg) & 1))
+                minst_sccp_meet(blk, val->reg, &l, &w, sc->state[p], p);
+            if ((val->kind != MINST_SSA_DEF) && !(sc->cmask[c] & f))
+                minst_sccp_meet(blk, val->reg, &l, &w, sc->clat[val->prev * sc->cnum + c], sc->cwit[val->prev * sc->cnum + c]);
+            break;
+
+        /* 只看可执行的前驱边，虚拟根来的参数只在入口块上算 */
+        case MINST_SSA_PHI:
+            for (i = 0, j = g->preds.start[p]; i < val->num; i++, j++) {
+                if ((j < g->preds.start[p + 1]) ? !sc->exec_edge[j] : !sc->entry[p])
+                    continue;
+
+                k = s->ops[val->prev + i] * sc->cnum + c;
+                minst_sccp_meet(blk, val->reg, &l, &w, sc->clat[k], sc->cwit[k]);
+            }
+            break;
+        }
+
+        if (l != lat[c]) {
+            lat[c] = l;
+            wit[c] = w;
+            changed = 1;
+        }
+    }
+
+    if (!changed)
+        return 0;
+
+    for (c = 0, l = MINST_SCCP_TOP, w = -1; c < sc->cnum; c++)
+        minst_sccp_meet(blk, val->reg, &l, &w, lat[c], wit[c]);
+    sc->lat[v] = l;
+    sc->wit[v] = w;
+    return 1;
+}
+
+static void         minst_sccp_push_val(struct minst_sccp *sc, int v)
+{
+    if (sc->in_v[v]) return;
+
+    sc->in_v[v] = 1;
+    sc->vwl[sc->vtop++] = v;
+}
+
+static void         minst_sccp_push_inst(struct minst_blk *blk, int id)
+{
+    struct minst_sccp *sc = blk->sccp;
+
+    if (sc->in_i[id] || !sc->exec_blk[blk->ssa.g.inst_blk[id]]) return;
+
+    sc->in_i[id] = 1;
+    sc->iwl[sc->itop++] = id;
+}
+
+/* 正在求值的指令查了值v，v 变了以后要重新求值 */
+static void         minst_sccp_dep(struct minst_sccp *sc, int v)
 {
-    struct minst_node *succ;
-    struct minst *minst;
-    struct bitset in = { 0 }, out = { 0 }, use = {0};
-    int i, changed = 1;
+    int e;
 
-    for (i = blk->allinst.len - 1; i >= 0; i--) {
-        minst = blk->allinst.ptab[i];
+    if ((sc->cur < 0) || ((sc->dep_head[v] >= 0) && (sc->dep_inst[sc->dep_head[v]] == sc->cur)))
+        return;
 
-        bitset_clear(&minst->in);
-        bitset_clear(&minst->out);
+    if (sc->dep_num == sc->dep_cap) {
+        sc->dep_cap = sc->dep_cap ? (sc->dep_cap * 2) : 1024;
+        sc->dep_next = (int *)realloc(sc->dep_next, sc->dep_cap * sizeof (sc->dep_next[0]));
+        sc->dep_inst = (int *)realloc(sc->dep_inst, sc->dep_cap * sizeof (sc->dep_inst[0]));
+        if (!sc->dep_next || !sc->dep_inst)
+            vm_error("minst_sccp_dep() realloc failure, %d", sc->dep_cap);
     }
 
-    while (changed) {
-        changed = 0;
-        for (i = blk->allinst.len - 1; i >= 0; i--) {
-            minst = blk->allinst.ptab[i];
-            if (minst->flag.dead_code || (minst->cfg && minst->cfg->flag.dead_code)) continue;
+    e = sc->dep_num++;
+    sc->dep_inst[e] = sc->cur;
+    sc->dep_next[e] = sc->dep_head[v];
+    sc->dep_head[v] = e;
+}
+
+/* 指令m入口处reg的格，是常量时返回带着这个常量的指令 */
+static struct minst*    minst_sccp_lookup(struct minst_blk *blk, struct minst *m, int reg, int *lat)
+{
+    struct minst_sccp *sc = blk->sccp;
+    int v;
 
-            bitset_clone(&in, &minst->in);
-            bitset_clone(&out, &minst->out);
-            bitset_clone(&use, &minst->use);
+    if ((v = minst_ssa_value(&blk->ssa, m, reg)) < 0) {
+        *lat = MINST_SCCP_BOTTOM;
+        return NULL;
+    }
 
-            bitset_clone(&minst->in, bitset_or(&use, bitset_sub(&minst->out, &minst->def)));
+    minst_sccp_dep(sc, v);
+    *lat = sc->lat[v];
 
-            for (succ = &minst->succs; succ; succ = succ->next) {
-                if (succ->minst)
-                    bitset_or(&minst->out, &succ->minst->in);
-            }
+    return (*lat == MINST_SCCP_CONST) ? blk->allinst.ptab[sc->wit[v]] : NULL;
+}
 
-            if (!changed && (!bitset_is_equal(&in, &minst->in) || !bitset_is_equal(&out, &minst->out)))
-                changed = 1;
-        }
+/* 块p到块b的边可执行了 */
+static void         minst_sccp_edge(struct minst_blk *blk, int p, int b)
+{
+    struct minst_sccp *sc = blk->sccp;
+    struct minst_ssa *s = &blk->ssa;
+    struct minst_df_graph *g = &s->g;
+    int j, r, v, newly = 0;
+
+    for (j = g->preds.start[b]; j < g->preds.start[b + 1]; j++) {
+        if ((g->preds.to[j] != p) || sc->exec_edge[j]) continue;
+        sc->exec_edge[j] = 1;
+        newly = 1;
     }
 
-    bitset_uninit(&in);
-    bitset_uninit(&out);
-    bitset_uninit(&use);
+    /* phi 多了一个参数，格没变也要让查过它的指令再看一遍，多路径的常量条件是逐个参数看的 */
+    for (r = 0; newly && (r < REGS_NUM); r++) {
+        v = s->entry[b * REGS_NUM + r];
+        if ((s->vals[v].kind != MINST_SSA_PHI) || (s->vals[v].inst != b)) continue;
 
-    return 0;
+        minst_sccp_val_eval(blk, v);
+        minst_sccp_push_val(sc, v);
+    }
+
+    if (!sc->exec_blk[b]) {
+        sc->exec_blk[b] = 1;
+        sc->bwl[sc->btop++] = b;
+    }
 }
 
-int                 minst_blk_dead_code_elim(struct minst_blk *blk)
+/* 块b的块尾指令m能走的后继。条件跳转按 blk->bcond_do 算出来的方向走，其他的后继都能走；
+删指令不改变块之间的路径，块尾指令删掉了也一样 */
+static void         minst_sccp_succs(struct minst_blk *blk, int b, struct minst *m)
 {
-    struct minst_cfg *cfg;
-    struct minst *minst;
-    int changed = 1, i, ret = 0;
-    struct bitset def = { 0 };
+    struct minst_sccp *sc = blk->sccp;
+    struct minst_df_graph *g = &blk->ssa.g;
+    struct minst_node *node;
+    int d = 3, j, lat, to;
+
+    if (!m->flag.dead_code && minst_is_bcond_it(m) && (minst_succs_count(m) > 1)) {
+        sc->cur = m->id;
+        minst_sccp_lookup(blk, m, ARM_REG_APSR, &lat);
+        d = ((lat == MINST_SCCP_TOP) && !m->flag.is_const && !sc->forced[m->id]) ? -2 : blk->bcond_do(blk->emu, m);
+        sc->cur = -1;
+
+        if ((d == -2) && sc->forced[m->id])
+            d = -1;
+        d = (d == -2) ? 0 : ((d < 0) ? 3 : (d ? 2 : 1));
+        if (!(d & ~sc->dirs[m->id]))
+            return;
+        sc->dirs[m->id] |= d;
 
-    /* FIXME: 删除死代码以后，liveness的计算没有把死代码计算进去 */
-    while (changed) {
-        changed = 0;
-        for (i = 0; i < blk->allinst.len; i++) {
-            minst = blk->allinst.ptab[i];
-            /* 
-            1. 死代码删除只在四元式中进行，函数不参与死代码删除计算
-            2. str指令不参与计算，因为有很强的副作用 */
-            if (minst->flag.dead_code || minst->flag.prologue || minst->flag.epilogue 
-                || (minst->type == mtype_bl)
-                || (minst->type == mtype_str)
-                || (minst->type == mtype_ldr))
+        minst_succs_foreach(m, node) {
+            if (!node->minst || (node->minst->id >= g->inst_num) || ((to = g->inst_blk[node->minst->id]) < 0))
                 continue;
-
-            /* 四元式一定有def的，没有def的指令一般是 bl, it, cmp等等*/
-            if (bitset_is_empty(&minst->def))
+            if ((d != 3) && (node->minst != ((d & 2) ? minst_get_true_label(m) : minst_get_false_label(m))))
                 continue;
 
-            bitset_clone(&def, &minst->def);
-            if (!changed && bitset_is_empty(bitset_and(&def, &minst->out))) {
-                minst_del_from_cfg(minst);
-                //printf("dead code elim, inst[%d]\n", minst->id);
-                ret = changed = 1;
-            }
-        }
-
-        minst_blk_liveness_calc(blk);
-    }
-
-    /* 删除一个节点且这个节点就是跳转指令的的cfg*/
-    for (i = 0; i < blk->allcfg.len; i++) {
-        cfg = blk->allcfg.ptab[i];
-        if (cfg->flag.dead_code) continue;
-        if (cfg->start != cfg->end) continue;
-        if (cfg->start->type != mtype_b) continue;
-        if ((minst_preds_count(cfg->start) == 1) && (minst_succs_count(cfg->end) == 1)) {
-            minst_del_from_cfg(cfg->start);
+            minst_sccp_edge(blk, b, to);
         }
+        return;
     }
 
-    bitset_uninit(&def);
+    if (sc->dirs[m->id])
+        return;
+    sc->dirs[m->id] = 3;
 
-    return ret;
+    for (j = g->preds_r.start[b]; j < g->preds_r.start[b + 1]; j++)
+        minst_sccp_edge(blk, b, g->preds_r.to[j]);
+    for (j = g->succs.start[b]; j < g->succs.start[b + 1]; j++)
+        minst_sccp_edge(blk, b, g->succs.to[j]);
 }
 
-int                 minst_get_def(struct minst *minst)
+static void         minst_sccp_inst(struct minst_blk *blk, int id)
 {
-    if (minst->ld == -1)
-        return minst->ld;
-
-    return minst->ld = bitset_next_bit_pos(&minst->def, 0);
-}
+    struct minst_sccp *sc = blk->sccp;
+    struct minst_df_graph *g = &blk->ssa.g;
+    struct minst *m = blk->allinst.ptab[id];
+    struct arm_cpsr apsr;
+    int r, lat, old = sc->state[id], imm, k, b = g->inst_blk[id];
+
+    if (!m->flag.dead_code && !sc->fixed[id] && (old != MINST_SCCP_BOTTOM) && !minst_is_bcond_it(m)) {
+        sc->cur = id;
+
+        /* 有操作数还是 TOP 的先不算 */
+        live_regs_foreach(&m->use, r) {
+            if (r >= REGS_NUM) break;
+            minst_sccp_lookup(blk, m, r, &lat);
+            if ((lat == MINST_SCCP_TOP) && !sc->forced[id]) break;
+        }
 
-int                 minst_get_use(struct minst *minst)
-{
-    int pos = bitset_next_bit_pos(&((minst)->use), 0);
+        if ((r < 0) || (r >= REGS_NUM)) {
+            imm = m->ld_imm;
+            apsr = m->apsr;
 
-    if (pos != ARM_REG_APSR) return pos;
+            m->flag.is_const = 0;
+            blk->minst_do(blk->emu, m);
 
-    int pos1 = bitset_next_bit_pos(&((minst)->use), pos + 1);
+            /* 同一条指令算出了两个不同的常量，就不是常量 */
+            if (m->flag.is_const && ((old == MINST_SCCP_TOP) || ((m->ld_imm == imm)
+                && (m->apsr.n == apsr.n) && (m->apsr.z == apsr.z) && (m->apsr.c == apsr.c) && (m->apsr.v == apsr.v)))) {
+                sc->state[id] = MINST_SCCP_CONST;
+            }
+            else {
+                m->flag.is_const = 0;
+                m->ld_imm = imm;
+                m->apsr = apsr;
+                sc->state[id] = MINST_SCCP_BOTTOM;
+            }
+        }
+        sc->cur = -1;
 
-    if (pos1 != -1) return pos1;
+        if (sc->state[id] != old) {
+            for (k = blk->ssa.def_start[id]; k < blk->ssa.def_start[id + 1]; k++) {
+                if (minst_sccp_val_eval(blk, blk->ssa.def_vals[k]))
+                    minst_sccp_push_val(sc, blk->ssa.def_vals[k]);
+            }
+        }
+    }
 
-    return pos;
+    if (id == g->insts[g->inst_start[b + 1] - 1])
+        minst_sccp_succs(blk, b, m);
 }
 
-int                 minst_blk_gen_reaching_definitions(struct minst_blk *blk)
+/* 工作表空了以后，可执行块里还在等 TOP 操作数的指令和还没走过的条件跳转不再等了，重新放回工作表，
+返回放回去了几条 */
+static int          minst_sccp_settle(struct minst_blk *blk)
 {
-    struct minst *minst;
-    BITSET_INIT(in);
-    BITSET_INIT(out);
-    struct minst_node *pred_node;
-    int i, changed = 1, def;
+    struct minst_sccp *sc = blk->sccp;
+    struct minst_df_graph *g = &blk->ssa.g;
+    struct minst *m;
+    int b, j, id, num = 0;
 
-    for (i = 0; i < blk->allinst.len; i++) {
-        minst = blk->allinst.ptab[i];
+    for (b = 0; b < g->num; b++) {
+        if (!sc->exec_blk[b]) continue;
 
-        bitset_clear(&minst->rd_in);
-        bitset_clear(&minst->rd_out);
-        bitset_clear(&minst->kills);
+        for (j = g->inst_start[b]; j < g->inst_start[b + 1]; j++) {
+            id = g->insts[j];
+            m = blk->allinst.ptab[id];
+            if (m->flag.dead_code || sc->fixed[id] || sc->forced[id]) continue;
 
-        if (minst->flag.epilogue || minst->flag.dead_code || minst->cfg->flag.dead_code || (def = minst_get_def(minst)) < 0)
-            continue;
-        bitset_clone(&minst->kills, &blk->defs[def]);
-        bitset_set(&minst->kills, minst->id, 0);
+            if (minst_is_bcond_it(m) ? ((j == g->inst_start[b + 1] - 1) && !sc->dirs[id]) : (sc->state[id] == MINST_SCCP_TOP)) {
+                sc->forced[id] = 1;
+                minst_sccp_push_inst(blk, id);
+                num++;
+            }
+        }
     }
 
-    while (changed) {
-        changed = 0;
+    return num;
+}
 
-        for (i = 0; i < blk->allinst.len; i++) {
-            minst = blk->allinst.ptab[i];
-            if (minst->flag.epilogue || minst->flag.dead_code || minst->cfg->flag.dead_code)
-                continue;
+/* 条件常量传播，Wegman, Zadeck 的稀疏条件常量传播(SCCP)。
 
-            bitset_clone(&in, &minst->rd_in);
-            bitset_clone(&out, &minst->rd_out);
+格在SSA值上：TOP(还没算到)，常量，BOTTOM(不是常量)，开始时全是 TOP，只会往下走。没有定值的 UNDEF
+一直是 TOP，和到达定值一样，走不到定值的路径不算数。
+每个值的格按定值指令的 dmask 分类记，FILTER/MAYDEF 按 kill_reg 整类丢掉，和到达定值的过滤一致。
+指令定值的格就是指令的格，常量放在指令的 ld_imm/apsr 上，求值交给 blk->minst_do。它在常量模式下
+通过 minst_get_last_const_definition 取操作数，传播过程中这个查询直接读格，同时记下是哪条指令
+查的，值变了只重新求值查过它的指令，不再沿着到达定值展开。进来时已经是常量的指令不再求值。
 
-            for (pred_node = &minst->preds; pred_node; pred_node = pred_node->next) {
-                if (!pred_node->minst)  continue;
+块只在有可执行的边走到时才可执行，phi 只看可执行的前驱边，所以循环里要靠回边才能证明的常量
+也找得出来。条件跳转的方向交给 blk->bcond_do 算，只把算出来的方向上的边标成可执行。
 
-                bitset_or(&minst->rd_in, &pred_node->minst->rd_out);
-            }
-            bitset_sub(bitset_clone(&minst->rd_out, &minst->rd_in), &minst->kills);
-            if (minst_get_def(minst) >= 0)
-                bitset_set(&minst->rd_out, minst->id, 1);
+传播期间不改IR，到了不动点以后才把只剩一个方向的条件跳转改成跳转(删掉另一条边)，新的常量指令
+加进 blk->const_insts。走不到的cfg留给 minst_blk_del_unreachable 删。
 
-            if (!changed && (!bitset_is_equal(&in, &minst->rd_in) || !bitset_is_equal(&out, &minst->rd_out))) {
-                changed = 1;
-            }
+返回是否有指令常量化或者删了边 */
+int                 minst_conditional_const_propagation(struct minst_blk *blk)
+{
+    struct minst_ssa *s = &blk->ssa;
+    struct minst_df_graph *g;
+    struct minst_sccp sc = {0};
+    struct minst_ssa_val *val;
+    struct minst *m;
+    int *from, *to, i, j, b, v, e, num, ret = 0;
+
+    minst_blk_ssa_update(blk);
+    g = &s->g;
+
+    blk->sccp = &sc;
+    sc.cur = -1;
+    sc.lat = minst_df_ints(s->val_num);
+    sc.wit = minst_df_ints(s->val_num);
+    sc.dep_head = minst_df_ints(s->val_num);
+    sc.vwl = minst_df_ints(s->val_num);
+    sc.in_v = minst_df_ints(s->val_num);
+    sc.state = minst_df_ints(g->inst_num);
+    sc.fixed = minst_df_ints(g->inst_num);
+    sc.forced = minst_df_ints(g->inst_num);
+    sc.dirs = minst_df_ints(g->inst_num);
+    sc.iwl = minst_df_ints(g->inst_num);
+    sc.in_i = minst_df_ints(g->inst_num);
+    sc.exec_blk = minst_df_ints(g->num);
+    sc.entry = minst_df_ints(g->num);
+    sc.bwl = minst_df_ints(g->num);
+    sc.exec_edge = minst_df_ints(g->preds.start[g->num]);
+
+    /* 按 dmask 给定值指令分类，不同的 dmask 不多 */
+    sc.cls = minst_df_ints(g->inst_num);
+    sc.cmask = (uint64_t *)calloc(g->inst_num + 1, sizeof (sc.cmask[0]));
+    if (!sc.cmask)
+        vm_error("minst_conditional_const_propagation() calloc failure");
+    sc.cnum = 1;
+    for (i = 0; i < g->inst_num; i++) {
+        for (j = 0; (j < sc.cnum) && (sc.cmask[j] != s->dmask[i]); j++);
+        if (j == sc.cnum)
+            sc.cmask[sc.cnum++] = s->dmask[i];
+        sc.cls[i] = j;
+    }
+    sc.clat = minst_df_ints(s->val_num * sc.cnum);
+    sc.cwit = minst_df_ints(s->val_num * sc.cnum);
+
+    /* 值之间的引用：DEF/MAYDEF/FILTER 引用 prev，PHI 引用参数 */
+    for (v = REGS_NUM, num = 0; v < s->val_num; v++)
+        num += (s->vals[v].kind == MINST_SSA_PHI) ? s->vals[v].num : 1;
+    from = minst_df_ints(num);
+    to = minst_df_ints(num);
+    for (v = REGS_NUM, num = 0; v < s->val_num; v++) {
+        val = &s->vals[v];
+        for (i = 0; i < ((val->kind == MINST_SSA_PHI) ? val->num : 1); i++, num++) {
+            from[num] = (val->kind == MINST_SSA_PHI) ? s->ops[val->prev + i] : val->prev;
+            to[num] = v;
         }
     }
+    minst_df_edges_build(&sc.users, s->val_num, from, to, num);
+    free(from);
+    free(to);
 
-    bitset_uninit(&in);
-    bitset_uninit(&out);
+    for (v = 0; v < s->val_num; v++) {
+        sc.lat[v] = MINST_SCCP_TOP;
+        sc.dep_head[v] = -1;
+    }
 
-    return 0;
-}
+    for (i = 0; i < g->inst_num; i++) {
+        m = blk->allinst.ptab[i];
+        sc.state[i] = MINST_SCCP_TOP;
+        if ((g->inst_blk[i] < 0) || m->flag.dead_code || !m->flag.is_const) continue;
+
+        sc.fixed[i] = 1;
+        sc.state[i] = MINST_SCCP_CONST;
+        for (j = s->def_start[i]; j < s->def_start[i + 1]; j++) {
+            if (minst_sccp_val_eval(blk, s->def_vals[j]))
+                minst_sccp_push_val(&sc, s->def_vals[j]);
+        }
+    }
 
-int                 minst_blk_value_numbering(struct minst_blk *blk)
-{
-    return 0;
-}
+    /* 入口只有 prologue 所在的块，别的没有前驱的块和到达定值里一样是走不到的 */
+    if ((b = g->inst_blk[0]) >= 0) {
+        sc.entry[b] = sc.exec_blk[b] = 1;
+        sc.bwl[sc.btop++] = b;
+        for (i = 0; i < REGS_NUM; i++) {
+            v = s->entry[b * REGS_NUM + i];
+            if ((s->vals[v].kind == MINST_SSA_PHI) && (s->vals[v].inst == b) && minst_sccp_val_eval(blk, v))
+                minst_sccp_push_val(&sc, v);
+        }
+    }
 
-int                 minst_blk_copy_propagation(struct minst_blk *blk)
-{
-    int i, use, changed = 1, ret = 0;
-    struct minst *m, *def_m;
-    BITSET_INITS(defs, blk->allinst.len);
+    /* 先把值传完，再求值指令，最后才走新的块，都空了再把还在等的放回来 */
+    while (sc.vtop || sc.itop || sc.btop || minst_sccp_settle(blk)) {
+        if (sc.vtop) {
+            v = sc.vwl[--sc.vtop];
+            sc.in_v[v] = 0;
 
-    while (changed) {
-        changed = 0;
-        for (i = 0; i < blk->allinst.len; i++) {
-            m = blk->allinst.ptab[i];
-            if ((m->type == mtype_mov_reg) || (m->type == mtype_ldr)) {
-                use = minst_get_use(m);
-                bitset_clone(&defs, &blk->defs[use]);
-                bitset_and(&defs, &m->rd_in);
+            for (j = sc.users.start[v]; j < sc.users.start[v + 1]; j++) {
+                if (minst_sccp_val_eval(blk, sc.users.to[j]))
+                    minst_sccp_push_val(&sc, sc.users.to[j]);
+            }
+            for (e = sc.dep_head[v]; e >= 0; e = sc.dep_next[e])
+                minst_sccp_push_inst(blk, sc.dep_inst[e]);
+        }
+        else if (sc.itop) {
+            i = sc.iwl[--sc.itop];
+            sc.in_i[i] = 0;
+            minst_sccp_inst(blk, i);
+        }
+        else {
+            b = sc.bwl[--sc.btop];
+            for (j = g->inst_start[b]; j < g->inst_start[b + 1]; j++)
+                minst_sccp_inst(blk, g->insts[j]);
+        }
+    }
 
-                if ((bitset_count(&defs) == 1)) {
-                    def_m = blk->allinst.ptab[bitset_1th(&defs)];
-                    if (m->preds.minst != def_m) continue;
+    blk->sccp = NULL;
 
-                    if ((m->type == mtype_mov_reg) && (def_m->type == mtype_mov_reg)
-                        && (minst_get_def(m) == minst_get_use(def_m)) && (minst_get_use(m) == minst_get_def(def_m))) {
-                        minst_del_from_cfg(m);
-                        ret = changed = 1; break;
-                    }
+    for (i = 0; i < g->inst_num; i++) {
+        if (sc.fixed[i] || (sc.state[i] != MINST_SCCP_CONST)) continue;
 
-                    if ((m->type == mtype_ldr) && (def_m->type == mtype_str)
-                        && (minst_get_def(m) == minst_get_use(def_m)) && (minst_get_use(m) == minst_get_def(def_m))) {
-                        minst_del_from_cfg(m);
-                        ret = changed = 1;  break;
-                    }
-                }
-            }
-        }
+        dynarray_add(&blk->const_insts, blk->allinst.ptab[i]);
+        ret = 1;
+    }
 
-        minst_blk_liveness_calc(blk);
-        minst_blk_gen_reaching_definitions(blk);
+    /* 条件跳转只剩一个方向能走的，改成跳转 */
+    for (b = 0; b < g->num; b++) {
+        if (!sc.exec_blk[b] || (g->inst_start[b + 1] == g->inst_start[b])) continue;
+
+        m = blk->allinst.ptab[g->insts[g->inst_start[b + 1] - 1]];
+        if (m->flag.dead_code || !minst_is_bcond_it(m) || (minst_succs_count(m) <= 1)) continue;
+        if ((sc.dirs[m->id] != 1) && (sc.dirs[m->id] != 2)) continue;
+
+        m->flag.is_const = 1;
+        m->flag.b_cond_passed = (sc.dirs[m->id] == 2);
+        blk->minst_do(blk->emu, m);
+        if (m->cfg)
+            printf("delete cfg [%d:%d-%d]\n", m->cfg->id, m->cfg->start->id, m->cfg->end->id);
+        ret = 1;
     }
 
-    bitset_uninit(&defs);
+    minst_df_edges_free(&sc.users);
+    free(sc.lat);
+    free(sc.wit);
+    free(sc.dep_head);
+    if (sc.dep_next) free(sc.dep_next);
+    if (sc.dep_inst) free(sc.dep_inst);
+    free(sc.vwl);
+    free(sc.in_v);
+    free(sc.clat);
+    free(sc.cwit);
+    free(sc.cls);
+    free(sc.cmask);
+    free(sc.state);
+    free(sc.fixed);
+    free(sc.forced);
+    free(sc.dirs);
+    free(sc.iwl);
+    free(sc.in_i);
+    free(sc.exec_blk);
+    free(sc.entry);
+    free(sc.bwl);
+    free(sc.exec_edge);
+
     return ret;
 }
 
-int                 minst_blk_regalloc(struct minst_blk *blk)
+int                 minst_get_const_defs(struct minst_blk *blk, struct minst *m, int reg, struct dynarray *defs)
 {
-    return 0;
-}
+    struct minst_sccp *sc = blk->sccp;
+    struct minst_ssa *s = &blk->ssa;
+    struct minst_df_graph *g = &s->g;
+    struct minst_ssa_val *val;
+    struct minst *def;
+    struct bitset *bs;
+    int v, i, j, p, top = -1, pos, count = 0;
+    uint64_t f;
+
+    defs->len = 0;
+
+    if (!sc) {
+        bs = minst_blk_scratch_get(blk);
+        minst_get_reaching_defs(blk, m, reg, bs);
+        bitset_foreach(bs, pos) {
+            def = blk->allinst.ptab[pos];
+            if (!def->flag.is_const) {
+                count = -1;
+                break;
+            }
+            dynarray_add(defs, def);
+            count++;
+        }
+        minst_blk_scratch_put(blk, bs);
+        return count;
+    }
 
-int                 minst_conditional_const_propagation(struct minst_blk *blk)
-{
-    struct minst_cfg *cfg;
-    int i;
+    if ((v = minst_ssa_value(s, m, reg)) < 0)
+        return -1;
+
+    /* 和 minst_ssa_reaching_defs 一样带着过滤掩码展开，只走可执行的边 */
+    s->q.cur++;
+    s->q.num = 0;
+    minst_ssa_push(s, &top, v, 0);
+    while (top >= 0) {
+        v = s->q.stack[top];
+        f = s->q.stack_mask[top--];
+        if (minst_ssa_seen(s, v, f)) continue;
+
+        val = &s->vals[v];
+        minst_sccp_dep(sc, v);
+
+        switch (val->kind) {
+        case MINST_SSA_DEF:
+        case MINST_SSA_MAYDEF:
+        case MINST_SSA_FILTER:
+            p = val->inst;
+            def = blk->allinst.ptab[p];
+            if (def->flag.dead_code) {
+                minst_ssa_push(s, &top, val->prev, f);
+                break;
+            }
+            if ((val->kind != MINST_SSA_FILTER) && ((s->dmask[p] >> reg) & 1) && !(s->dmask[p] & f)) {
+                if (sc->state[p] == MINST_SCCP_BOTTOM)
+                    return -1;
+                for (i = 0; (i < defs->len) && (defs->ptab[i] != def); i++);
+                if ((sc->state[p] == MINST_SCCP_CONST) && (i == defs->len))
+                    dynarray_add(defs, def);
+            }
+            if (val->kind != MINST_SSA_DEF)
+                minst_ssa_push(s, &top, val->prev, f | ((val->kill_reg < REGS_NUM) ? (1ull << val->kill_reg) : 0));
+            break;
 
-    for (i = 0; i < blk->allcfg.len; i++) {
-        cfg = blk->allcfg.ptab[i];
+        case MINST_SSA_PHI:
+            for (i = 0, j = g->preds.start[val->inst]; i < val->num; i++, j++) {
+                if ((j < g->preds.start[val->inst + 1]) ? !sc->exec_edge[j] : !sc->entry[val->inst])
+                    continue;
+                minst_ssa_push(s, &top, s->ops[val->prev + i], f);
+            }
+            break;
+        }
     }
-    return 0;
+
+    return defs->len;
 }
 
 struct minst*       minst_get_last_const_definition(struct minst_blk *blk, struct minst *minst, int regm)
 {
     int pos, count, imm, i, j;
-    BITSET_INIT(bs);
-    BITSET_INIT(bs2);
+    struct bitset *bs, *bs2;
     struct minst *const_minst = NULL, *t, *n, *cm = NULL;
 
-    bitset_clone(&bs, &minst->rd_in);
-    bitset_and(&bs, &blk->defs[regm]);
+    /* 常量传播过程中直接读格 */
+    if (blk->sccp) {
+        cm = minst_sccp_lookup(blk, minst, regm, &i);
+        return cm ? cm : minst_ssa_const(blk, minst, regm);
+    }
+
+    bs = minst_blk_scratch_get(blk);
+    bs2 = minst_blk_scratch_get(blk);
+
+    minst_get_reaching_defs(blk, minst, regm, bs);
 
-    count = bitset_count(&bs);
+    count = bitset_count(bs);
     if (!count) goto exit;
 
     if (count == 1) {
-        pos = bitset_next_bit_pos(&bs, 0);
+        pos = bitset_next_bit_pos(bs, 0);
         cm  = blk->allinst.ptab[pos];
     } else {
-        pos = bitset_next_bit_pos(&bs, 0);
+        pos = bitset_next_bit_pos(bs, 0);
 
-        bitset_foreach(&bs, pos) {
+        bitset_foreach(bs, pos) {
             const_minst = blk->allinst.ptab[pos];
             if (const_minst->flag.is_const)
                 break;
@@ -831,24 +3834,20 @@ struct minst*       minst_get_last_const_definition(struct minst_blk *blk, struc
         cm = const_minst;
         imm = const_minst->ld_imm;
 
-        bitset_foreach(&bs, pos) {
+        bitset_foreach(bs, pos) {
             const_minst = blk->allinst.ptab[pos];
             if (!const_minst->flag.is_const) {
-                if (const_minst->type != mtype_mov_reg) {
-                    bitset_uninit(&bs);
-                    return NULL;
-                }
+                if (const_minst->type != mtype_mov_reg)
+                    goto fail_label;
 
                 int use = minst_get_use(const_minst);
-                bitset_clear(&bs2);
-                bitset_clone(&bs2, &blk->defs[use]);
-                bitset_and(&bs2, &const_minst->rd_in);
-                bitset_foreach(&bs2, i) {
+                minst_get_reaching_defs(blk, const_minst, use, bs2);
+                bitset_foreach(bs2, i) {
                     t = blk->allinst.ptab[i];
 
                     if ((t->type != mtype_mov_reg) || (minst_get_use(t) != regm))  goto fail_label;
 
-                    bitset_foreach(&bs, j) {
+                    bitset_foreach(bs, j) {
                         n = blk->allinst.ptab[j];
                         if (!n->flag.is_const && minst_get_use(n) == use) continue;
                         if (n->flag.is_const && (n->ld_imm == imm)) continue;
@@ -863,32 +3862,27 @@ struct minst*       minst_get_last_const_definition(struct minst_blk *blk, struc
         }
     }
 exit:
-    bitset_uninit(&bs);
-    bitset_uninit(&bs2);
-    return (cm && cm->flag.is_const) ? cm : NULL;
+    minst_blk_scratch_put(blk, bs2);
+    minst_blk_scratch_put(blk, bs);
+    return (cm && cm->flag.is_const) ? cm : minst_ssa_const(blk, minst, regm);
 
 fail_label:
-    bitset_uninit(&bs);
-    bitset_uninit(&bs2);
-    return NULL;
+    minst_blk_scratch_put(blk, bs2);
+    minst_blk_scratch_put(blk, bs);
+    return minst_ssa_const(blk, minst, regm);
 }
 
 struct minst*       minst_get_last_def(struct minst_blk *blk, struct minst *minst, int regm)
 {
-    int pos, count;
-    BITSET_INIT(bs);
+    struct bitset *bs = minst_blk_scratch_get(blk);
     struct minst *def_minst = NULL;
 
-    bitset_clone(&bs, &minst->rd_in);
-    bitset_and(&bs, &blk->defs[regm]);
+    minst_get_reaching_defs(blk, minst, regm, bs);
 
-    count = bitset_count(&bs);
-    if (!count) return NULL;
+    if (bitset_count(bs) == 1)
+        def_minst = blk->allinst.ptab[bitset_1th(bs)];
 
-    if (count == 1) {
-        pos = bitset_next_bit_pos(&bs, 0);
-        def_minst = blk->allinst.ptab[pos];
-    }
+    minst_blk_scratch_put(blk, bs);
 
     return def_minst;
 }
@@ -924,47 +3918,154 @@ int                 minst_blk_is_on_start_unique_path(struct minst_blk *blk, str
     return 0;
 }
 
+/* 把src拷贝一份插到pos前面，pos必须是某个cfg的入口，并且只有一个前驱 */
+static struct minst*    minst_insert_copy(struct minst *pos, struct minst *src)
+{
+    struct minst_blk *blk = pos->blk;
+    struct minst_cfg *cfg = pos->cfg;
+    struct minst *dst = minst_new(blk, NULL, 0, NULL), *pred = NULL;
+    struct minst_node *pred_node;
+    int r;
+
+    dst->addr = minst_blk_text_alloc(blk, src->len);
+    dst->len = src->len;
+    dst->reg_node = src->reg_node;
+    dst->def = src->def;
+    dst->use = src->use;
+    dst->flag.is_const = src->flag.is_const;
+    dst->flag.decoded = src->flag.decoded;
+    dst->ld_imm = src->ld_imm;
+    dst->ctx = src->ctx;
+    dst->cfg = cfg;
+    dst->copy_from = src;
+    dst->type = src->type;
+    dst->temp = src->temp;
+    memcpy(dst->addr, src->addr, src->len);
+
+    live_regs_foreach(&dst->def, r) {
+        if (r < REGS_NUM) bitset_set(&blk->defs[r], dst->id, 1);
+    }
+    live_regs_foreach(&dst->use, r) {
+        if (r < REGS_NUM) bitset_set(&blk->uses[r], dst->id, 1);
+    }
+
+    minst_preds_foreach(pos, pred_node) {
+        if ((pred = pred_node->minst)) break;
+    }
+
+    minst_replace_edge(pred, pos, dst);
+    minst_add_edge(dst, pos);
+    cfg->start = dst;
+
+    return dst;
+}
+
+#define MINST_OOO_SUCCS         4
+
 int                 minst_blk_out_of_order(struct minst_blk *blk)
 {
     struct minst_cfg *cfg;
-    struct minst *minst, *cminst;
-    struct minst_node *succ_node;
-    struct bitset live_out, tmp_in;
-    int i, pos;
-
-    bitset_init(&live_out, blk->allinst.len);
-    bitset_init(&tmp_in, blk->allinst.len);
+    struct minst *minst, *m, *succs[MINST_OOO_SUCCS], **insts = NULL;
+    struct minst_node *succ_node, *pred_node;
+    int i, j, k, n, num, cap = 0, reg, u, live, moved = 0, total = 0, ok[MINST_OOO_SUCCS], to[MINST_OOO_SUCCS];
 
-    for (i = 0; i < blk->allcfg.len; i++) {
-        cfg = blk->allcfg.ptab[i];
+    do {
+        moved = 0;
 
-        /* 不计算单节点的乱序情况 */
-        if (!cfg->end->succs.next) continue;
-        /* 不处理it指令导致的跳转 */
-        if (!minst_is_b0(cfg->end)) continue;
+        for (i = 0; i < blk->allcfg.len; i++) {
+            cfg = blk->allcfg.ptab[i];
 
-        bitset_clone(&live_out, &cfg->end->out);
-        bitset_sub(&live_out, &cfg->start->in);
+            /* 只处理b/bcond结尾、有多个后继的cfg，it指令导致的跳转不处理 */
+            if (cfg->flag.dead_code || cfg->flag.prologue || cfg->flag.epilogue || !cfg->end) continue;
+            if (!cfg->end->succs.next || !minst_is_b0(cfg->end) || cfg->end->flag.in_it_block) continue;
 
-        bitset_foreach(&live_out, pos) {
-            for (succ_node = &cfg->end->succs; succ_node; succ_node = succ_node->next) {
+            /* 只能往独占的后继里插：后继是某个cfg的入口，并且唯一的前驱就是当前的跳转指令，
+            不然要切边，这里不做 */
+            n = 0;
+            minst_succs_foreach(cfg->end, succ_node) {
                 if (!(minst = succ_node->minst)) continue;
+                if (n == MINST_OOO_SUCCS) break;
+
+                ok[n] = minst->cfg && (minst->cfg != cfg) && !minst_is_dead_code(minst)
+                    && (minst->cfg->start == minst) && !minst->cfg->flag.epilogue
+                    && !minst->flag.in_it_block && !minst->flag.epilogue
+                    && (minst_preds_count(minst) == 1);
+                if (ok[n]) {
+                    minst_preds_foreach(minst, pred_node) {
+                        if (pred_node->minst && (pred_node->minst != cfg->end)) ok[n] = 0;
+                    }
+                }
+                succs[n++] = minst;
+            }
+            if (succ_node || (n < 2)) continue;
+
+            num = minst_cfg_inst_count(cfg);
+            if (num > cap) {
+                cap = num;
+                insts = realloc(insts, cap * sizeof (insts[0]));
+                if (!insts)
+                    vm_error("minst_blk_out_of_order() realloc failure");
+            }
+            for (k = 0, m = cfg->start; m; m = m->succs.minst) {
+                insts[k++] = m;
+                if (m == cfg->end) break;
+            }
 
-                /* 可以乱序的条件
-                1. 不在跳转cfg的入口活跃节点中 
-                2. 是常量
-                3. 在当前cfg内被定义过，但从没在定义处到当前cfg末尾处使用过
+            /* 从后往前扫，这样movw/movt这种前后依赖的指令，插到后继里以后顺序还是对的 */
+            for (k = num - 2; k >= 0; k--) {
+                minst = insts[k];
+
+                /* 可以下沉的条件
+                1. 纯运算，只定值一个寄存器，没有副作用
+                2. 从定义处到cfg末尾，定值的寄存器没被用过，也没被重新定值过，use的寄存器也没被改过
+                3. 在部分后继的入口活跃，而且这些后继都是独占的
                 */
-                if (!bitset_get(&minst->in, pos) && (cminst = minst_get_last_const_definition(blk, cfg->end, pos)))
-                    printf("minst[%d] reg:r%d = 0x%x need out of order\n", cfg->end->id, pos, cminst->ld_imm);
+                if (minst->flag.dead_code) continue;
+                if (((minst->type != mtype_null) && (minst->type != mtype_mov_reg))
+                    || !minst_vn_simple(minst) || !blk->pure_do || !blk->pure_do(minst))
+                    continue;
+
+                live_regs_foreach(&minst->def, reg) break;
+                if ((reg == ARM_REG_SP) || !live_regs_get(&cfg->end->out, reg)) continue;
+
+                for (j = k + 1; j < num; j++) {
+                    m = insts[j];
+                    if (m->flag.dead_code) continue;
+                    if (live_regs_get(&m->use, reg) || live_regs_get(&m->def, reg)) break;
+                    live_regs_foreach(&minst->use, u) {
+                        if (live_regs_get(&m->def, u)) break;
+                    }
+                    if (u >= 0) break;
+                }
+                if (j < num) continue;
+
+                for (j = live = 0; j < n; j++) {
+                    to[j] = live_regs_get(&succs[j]->in, reg);
+                    if (to[j] && !ok[j]) break;
+                    live += to[j];
+                }
+                if ((j < n) || !live || (live == n)) continue;
+
+                for (j = 0; j < n; j++) {
+                    if (to[j]) minst_insert_copy(succs[j]->cfg->start, minst);
+                }
+                minst_del_from_cfg(minst);
+                moved++;
             }
         }
-    }
 
-    bitset_uninit(&tmp_in);
-    bitset_uninit(&live_out);
+        if (moved)
+            minst_blk_liveness_calc(blk);
 
-    return 0;
+        total += moved;
+    } while (moved);
+
+    if (insts)
+        free(insts);
+
+    minst_blk_ssa_update(blk);
+
+    return total;
 }
 
 struct minst*       minst_trace_get_def(struct minst_blk *blk, int regm, int *index, int before)
@@ -989,7 +4090,7 @@ struct minst*       minst_trace_get_def(struct minst_blk *blk, int regm, int *in
 int                 minst_trace_get_defs(struct minst_blk *blk, int regm, int before, struct bitset *defs)
 {
     struct minst *m, *end, *m1;
-    BITSET_INITS(all, blk->allinst.len);
+    struct bitset *all = minst_blk_scratch_get(blk);
     struct minst_node *succ_node;
     struct minst *stack[512];
     int stack_top = -1;
@@ -1003,28 +4104,26 @@ int                 minst_trace_get_defs(struct minst_blk *blk, int regm, int be
 
     while (!MSTACK_IS_EMPTY(stack)) {
         m = MSTACK_POP(stack);
-        bitset_set(&all, m->id, 1);
+        bitset_set(all, m->id, 1);
         if (m == end) continue;
 
         minst_succs_foreach(m, succ_node) {
             m1 = succ_node->minst;
-            if (m1 && !bitset_get(&all, m1->id))
+            if (m1 && !bitset_get(all, m1->id))
                 MSTACK_PUSH(stack, m1);
         }
     }
 
-    bitset_clear(defs);
-    /* 取出所有对regm定值的语句 */
-    bitset_clone(defs, &blk->defs[regm]);
     /* 在end入口点活跃的regm的定制语句*/
-    bitset_and(defs, &end->rd_in);
+    minst_get_reaching_defs(blk, end, regm, defs);
     if (regm == 9) {
         bitset_dump(&blk->defs[regm]);
         bitset_dump(defs);
         //bitset_dump(&all);
     }
     /* 在当前trace流中活跃的regm定值语句 */
-    bitset_and(defs, &all);
+    bitset_and(defs, all);
+    minst_blk_scratch_put(blk, all);
 
     return bitset_count(defs);
 }
@@ -1121,31 +4220,20 @@ int                 minst_cfg_is_csm(struct minst_cfg *cfg)
 int                 minst_cfg_classify(struct minst_blk *blk)
 {
     struct minst *m;
-    struct minst_cfg *cfg, *tcfg, *pcfg;
-    struct minst_cfg *stack[256];
-    struct minst_node *succ_node, *pred_node;
-    int stack_top = -1;
-    int i;
+    struct minst_cfg *cfg;
+    struct minst_dom *dom = minst_blk_dom(blk);
+    int *stack, stack_top = -1, i, j, k, p, num;
 
     BITSET_INITS(visitall, blk->allcfg.len);
 
+    stack = minst_df_ints(dom->num);
+
+    /* 从状态机出发能走到的都是状态机内的节点 */
     cfg = blk->csm.cfg;
     printf("csm[%d:%d-%d]\n", cfg->id, cfg->start->id, cfg->end->id);
-    MSTACK_PUSH(stack, cfg);
-    bitset_set(&visitall, cfg->id, 1);
-    while (!MSTACK_IS_EMPTY(stack)) {
-        cfg = MSTACK_POP(stack);
-
-        minst_succs_foreach(cfg->end, succ_node) {
-            if (!succ_node->minst) continue;
-            tcfg = (succ_node->minst->cfg);
-            if (!tcfg || tcfg->flag.dead_code) continue;
-            if (bitset_get(&visitall, tcfg->id)) continue;
-
-            MSTACK_PUSH(stack, tcfg);
-            bitset_set(&visitall, tcfg->id, 1);
-        }
-    }
+    num = minst_df_order(dom->num, &dom->succs, &cfg->id, 1, stack, NULL);
+    for (i = 0; i < num; i++)
+        bitset_set(&visitall, stack[i], 1);
 
     bitset_foreach(&visitall, i) {
         cfg = blk->allcfg.ptab[i];
@@ -1166,27 +4254,25 @@ int                 minst_cfg_classify(struct minst_blk *blk)
     bitset_clear(&visitall);
     bitset_foreach(&blk->funcends, i) {
         m = blk->allinst.ptab[i];
-        MSTACK_PUSH(stack, m->cfg);
+        if (bitset_get(&visitall, m->cfg->id)) continue;
+        stack[++stack_top] = m->cfg->id;
         bitset_set(&visitall, m->cfg->id, 1);
     }
-    while (!MSTACK_IS_EMPTY(stack)) {
-        cfg = MSTACK_POP(stack);
-        if (cfg->id == 0) continue;
-
-        minst_preds_foreach(cfg->start, pred_node) {
-            if (!pred_node->minst) continue;
-            pcfg = pred_node->minst->cfg;
+    while (stack_top >= 0) {
+        i = stack[stack_top--];
+        if (i == 0) continue;
 
-            if (bitset_get(&visitall, pcfg->id)) continue;
+        for (j = dom->preds.start[i]; j < dom->preds.start[i + 1]; j++) {
+            p = dom->preds.to[j];
+            if (bitset_get(&visitall, p)) continue;
 
-            minst_succs_foreach(pcfg->end, succ_node) {
-                tcfg = succ_node->minst->cfg;
-                if (!bitset_get(&visitall, tcfg->id)) break;
+            for (k = dom->succs.start[p]; k < dom->succs.start[p + 1]; k++) {
+                if (!bitset_get(&visitall, dom->succs.to[k])) break;
             }
 
-            if (!succ_node) {
-                MSTACK_PUSH(stack, pcfg);
-                bitset_set(&visitall, pcfg->id, 1);
+            if (k == dom->succs.start[p + 1]) {
+                stack[++stack_top] = p;
+                bitset_set(&visitall, p, 1);
             }
         }
     }
@@ -1196,6 +4282,9 @@ int                 minst_cfg_classify(struct minst_blk *blk)
         cfg->csm = CSM_OUT;
     }
 
+    bitset_uninit(&visitall);
+    free(stack);
+
     return 0;
 }
 
@@ -1264,35 +4353,23 @@ int                 minst_bcond_symbo_exec(struct minst_cfg *cfg, struct minst *
 
 int                 minst_blk_del_unreachable(struct minst_blk *blk)
 {
-    struct minst *succ;
-    struct minst_node *succ_node;
-    struct minst_cfg *stack[128], *cfg;
-    int stack_top = -1, pos, changed = 0;
-    BITSET_INITS(visit, blk->allcfg.len);
-
-    MSTACK_PUSH(stack, blk->allcfg.ptab[0]);
-
-    while (!MSTACK_IS_EMPTY(stack)) {
-        cfg = MSTACK_POP(stack);
-        bitset_set(&visit, cfg->id, 1);
+    struct minst_dom *dom = minst_blk_dom(blk);
+    struct minst_cfg *cfg;
+    int i, changed = 0;
 
-        minst_succs_foreach(cfg->end, succ_node) {
-            if (!(succ = succ_node->minst) || !succ->cfg) continue;
-            if (bitset_get(&visit, succ->cfg->id)) continue;
+    /* 支配树上没有的节点就是从入口走不到的 */
+    for (i = 0; i < blk->allcfg.len; i++) {
+        cfg = blk->allcfg.ptab[i];
+        if (cfg->flag.dead_code || (dom->idom[i] != -2)) continue;
 
-            MSTACK_PUSH(stack, succ->cfg);
-        }
+        changed = 1;
+        cfg->flag.dead_code = 1;
+        printf("cfg[%d] is be deleted\n", cfg->id);
     }
 
-    /* 取反就是所有没访问过的节点 */
-    bitset_not(&visit);
-    bitset_foreach(&visit, pos) {
-        cfg = blk->allcfg.ptab[pos];
-        if (!cfg->flag.dead_code) {
-            changed = 1;
-            cfg->flag.dead_code = 1;
-            printf("cfg[%d] is be deleted\n", cfg->id);
-        }
+    if (changed) {
+        minst_blk_dom_invalidate(blk);
+        minst_blk_ssa_invalidate(blk);
     }
 
     return changed;
@@ -1333,13 +4410,16 @@ struct minst_temp * minst_temp_alloc(struct minst_blk *blk, unsigned long addr)
 
     if ((temp = minst_temp_get(blk, addr))) return temp;
 
-    temp = calloc(1, sizeof (temp[0]));
+    temp = marena_alloc(&blk->arena, sizeof (temp[0]));
     if (!temp)
         vm_error("minst_temp_alloc() alloc failure");
 
     temp->addr = addr;
     /* 前32个是系统保留寄存器变量 */
     temp->tid = (blk->tvar_id++) + 32;
+    /* 活跃性的位掩码是定长的，放不下的临时变量会丢掉 def/use，直接报错 */
+    if (temp->tid >= LIVE_REGS_NUM)
+        vm_error("minst_temp_alloc() too many stack temps, tid:%d >= LIVE_REGS_NUM:%d", temp->tid, LIVE_REGS_NUM);
     dynarray_add(&blk->tvar, temp);
 
     return temp;
@@ -1362,7 +4442,7 @@ struct minst_temp * minst_temp_get(struct minst_blk *blk, unsigned long addr)
 void    minst_dump_defs(struct minst_blk *blk, int inst_id, int reg_def)
 {
     struct minst *minst, *def_minst;
-    BITSET_INIT(defs);
+    struct bitset *defs;
     int pos;
 
     if (inst_id >= blk->allinst.len)
@@ -1370,11 +4450,11 @@ void    minst_dump_defs(struct minst_blk *blk, int inst_id, int reg_def)
 
     minst = blk->allinst.ptab[inst_id];
 
-    bitset_clone(&defs, &blk->defs[reg_def]);
-    bitset_and(&defs, &minst->rd_in);
+    defs = minst_blk_scratch_get(blk);
+    minst_get_reaching_defs(blk, minst, reg_def, defs);
 
     printf("[inst_id:%d] %s def list\n", inst_id, arm_reg2str(reg_def));
-    bitset_foreach(&defs, pos) {
+    bitset_foreach(defs, pos) {
         def_minst = blk->allinst.ptab[pos];
         if (def_minst->flag.is_const)
             printf("%d const=0x%x\n", pos, def_minst->ld_imm);
@@ -1385,21 +4465,24 @@ void    minst_dump_defs(struct minst_blk *blk, int inst_id, int reg_def)
     }
     printf("\n");
 
-    bitset_uninit(&defs);
+    minst_blk_scratch_put(blk, defs);
 }
 
 int minst_dob_analyze(struct minst_blk *blk)
 {
     int i, count, max = -1;
-    struct minst_cfg *cfg, *csm_cfg;
+    struct minst_cfg *cfg, *csm_cfg = NULL;
     struct minst *cmp, *m;
+    struct minst_dom *dom = minst_blk_dom(blk);
 
     blk->csm.st_reg = -1;
     blk->csm.save_reg = -1;
 
-    /* FIXME: 现在选择有最大前驱节的cfg做为csm.cfg */
+    /* 所有的case块最后都跳回状态机的分发块，所以它一定是一个循环头
+    FIXME: 现在选择有最大前驱节的循环头做为csm.cfg */
     for (i = 0; i < blk->allcfg.len; i++) {
         cfg = blk->allcfg.ptab[i];
+        if (dom->loop_header[i] != i) continue;
         if (((count = minst_preds_count(cfg->start)) >= 7) && (count > max)) {
             csm_cfg = cfg;
             max = count;
@@ -1430,17 +4513,16 @@ int minst_dob_analyze(struct minst_blk *blk)
 
 int minst_dump_csm(struct minst_blk *blk)
 {
-    BITSET_INIT(defs);
+    struct bitset *defs = minst_blk_scratch_get(blk);
     struct minst *m;
     int i;
 
-    bitset_clone(&defs, &blk->defs[blk->csm.trace_reg]);
-    bitset_and(&defs, &blk->csm.cfg->start->rd_in);
+    minst_get_reaching_defs(blk, blk->csm.cfg->start, blk->csm.trace_reg, defs);
 
     printf("csm[%d] base_reg[r%d] st_reg[r%d] save_reg[%d]\n", 
         blk->csm.cfg->id, blk->csm.base_reg, blk->csm.st_reg, blk->csm.save_reg);
 
-    bitset_foreach(&defs, i) {
+    bitset_foreach(defs, i) {
         m = blk->allinst.ptab[i];
         if (m->flag.is_const) {
             if (m->ld_imm > 0)
@@ -1462,15 +4544,16 @@ int minst_dump_csm(struct minst_blk *blk)
         }
     }
 
+    minst_blk_scratch_put(blk, defs);
+
     return 0;
 }
 
 int minst_get_all_const_definition(struct minst_blk *blk, struct minst *m, struct dynarray *d)
 {
     struct minst *stack[128], *t, *t2;
-    int stack_top = -1, i, use;
-    BITSET_INIT(defs);
-    BITSET_INIT(rlist);
+    int stack_top = -1, i, use, ret = 0;
+    struct bitset *defs = minst_blk_scratch_get(blk);
 
     dynarray_reset(d);
 
@@ -1494,10 +4577,9 @@ int minst_get_all_const_definition(struct minst_blk *blk, struct minst *m, struc
         case mtype_ldr:
         case mtype_str:
             use = minst_get_use(t);
-            bitset_clone(&defs, &blk->defs[use]);
-            bitset_and(&defs, &t->rd_in);
+            minst_get_reaching_defs(blk, t, use, defs);
 
-            bitset_foreach(&defs, i) {
+            bitset_foreach(defs, i) {
                 t2 = blk->allinst.ptab[i];
                 MSTACK_PUSH(stack, t2);
             }
@@ -1507,25 +4589,27 @@ int minst_get_all_const_definition(struct minst_blk *blk, struct minst *m, struc
             break;
 
         default:
-            return -1;
+            ret = -1;
+            goto exit;
         }
     }
 
-    return 0;
+exit:
+    minst_blk_scratch_put(blk, defs);
+    return ret;
 }
 
 int minst_get_all_const_definition2(struct minst_blk *blk, struct minst *m, int regm, struct dynarray *d)
 {
     struct minst *t;
-    BITSET_INIT(defs);
+    struct bitset *defs = minst_blk_scratch_get(blk);
     int i, j;
 
     dynarray_reset(d);
 
-    bitset_clone(&defs, &blk->defs[regm]);
-    bitset_and(&defs, &m->rd_in);
+    minst_get_reaching_defs(blk, m, regm, defs);
 
-    bitset_foreach(&defs, i) {
+    bitset_foreach(defs, i) {
         t = blk->allinst.ptab[i];
 
         if (!t->flag.is_const)
@@ -1540,22 +4624,19 @@ int minst_get_all_const_definition2(struct minst_blk *blk, struct minst *m, int
             dynarray_add(d, t);
     }
 
+    minst_blk_scratch_put(blk, defs);
+
     return 0;
 }
 
 int minst_get_free_reg(struct minst *m)
 {
     int i;
-    BITSET_INIT(def);
 
-    bitset_clone(&def, &m->out);
-    bitset_not(&def);
-    bitset_foreach(&def, i) {
-        if (i < 16)
-            break;
+    for (i = 0; i < 16; i++) {
+        if (!live_regs_get(&m->out, i))
+            return i;
     }
 
-    bitset_uninit(&def);
-
-    return (i < 16) ? i : -1;
+    return -1;
 }
@@ -21,10 +21,305 @@ enum minst_type {
     mtype_pop,
 };
 
+struct minst;
+struct minst_cfg;
+struct minst_sccp;
+
 typedef int(* minst_parse_callback)(void *emu, struct minst *minst);
+/* 条件跳转(或者IT)的条件成立返回1，不成立返回0，定不下来返回-1，操作数还没算出来返回-2。
+只回答，不改IR，常量传播按返回值决定哪些边可以走 */
+typedef int(* minst_bcond_callback)(void *emu, struct minst *minst);
+/* 指令是没有副作用的纯运算，结果只由指令编码和 use 的寄存器决定时返回1 */
+typedef int(* minst_pure_callback)(struct minst *minst);
+/* 把指令编码里的寄存器字段清零写到 code 里，各字段里的寄存器号按字段顺序写到 regs 里(最多
+MINST_FIELDS_MAX 个)，返回字段数。值是PC的字段其实是操作码的一部分，不清零，regs 里是-1；
+认不出字段、或者字段和 use/def 对不上的返回0 */
+#define MINST_FIELDS_MAX    3
+typedef int(* minst_fields_callback)(struct minst *minst, unsigned char *code, int *regs);
+/* 按 map 把指令里的寄存器r换成 map[r] 重新编码，成功返回0。map 为 NULL 时只问能不能改，
+返回能改成的寄存器掩码，0 是不能改 */
+typedef int(* minst_rename_callback)(struct minst *minst, int *map);
 
 #define REGS_NUM             (SYS_REG_NUM + 32)
 
+/* 活跃性分析只跟踪寄存器和栈上临时变量，用定长的位掩码就够了，传递函数只是几条
+位运算，不需要分配内存。临时变量的编号会超过 REGS_NUM(blk->defs/uses 只记录到
+REGS_NUM)，所以掩码多留一些位。临时变量的编号是 tvar_id + 32，最多 LIVE_REGS_NUM - 32 个，
+再多 minst_temp_alloc 直接报错，不会悄悄丢掉 */
+#define LIVE_REGS_NUM        256
+#define LIVE_REGS_WORDS      (LIVE_REGS_NUM / 64)
+
+struct live_regs {
+    uint64_t    w[LIVE_REGS_WORDS];
+};
+
+#define live_regs_clear(r)          memset((r), 0, sizeof (struct live_regs))
+#define live_regs_get(r, reg)       (((reg) >= 0) && ((reg) < LIVE_REGS_NUM) && (((r)->w[(reg) / 64] >> ((reg) % 64)) & 1))
+#define live_regs_foreach(r, _i) \
+    for (_i = live_regs_next(r, 0); _i >= 0; _i = live_regs_next(r, _i + 1))
+
+static inline void live_regs_set(struct live_regs *r, int reg, int val)
+{
+    if ((reg < 0) || (reg >= LIVE_REGS_NUM))
+        return;
+
+    if (val)
+        r->w[reg / 64] |= 1ull << (reg % 64);
+    else
+        r->w[reg / 64] &= ~(1ull << (reg % 64));
+}
+
+static inline int live_regs_is_empty(const struct live_regs *r)
+{
+    int i;
+
+    for (i = 0; i < LIVE_REGS_WORDS; i++) {
+        if (r->w[i])
+            return 0;
+    }
+
+    return 1;
+}
+
+/* 从pos开始找下一个置位的寄存器，没有返回-1 */
+static inline int live_regs_next(const struct live_regs *r, int pos)
+{
+    uint64_t v;
+
+    while ((pos >= 0) && (pos < LIVE_REGS_NUM)) {
+        v = r->w[pos / 64] >> (pos % 64);
+        if (!v) {
+            pos = (pos / 64 + 1) * 64;
+            continue;
+        }
+
+        while (!(v & 1)) {
+            v >>= 1;
+            pos++;
+        }
+
+        return (pos < LIVE_REGS_NUM) ? pos : -1;
+    }
+
+    return -1;
+}
+
+/* 单调数据流分析框架。
+
+按指令之间的边把指令切成直线段(数据流块)，块内只有一条路径，所以块内指令的传递函数
+可以合成一个 gen/kill 摘要。求解时先在块级别跑 worklist，前向问题按逆后序入队，
+后向问题按后序入队，只有输入变化的块才会被重新计算；每条指令上的集合由具体的分析
+按需从块的结果展开。
+
+切块只看指令边，不依赖 minst_cfg，因为 epilogue 指令不在任何 cfg 里，trace 化简以后
+cfg 的划分也不一定还和边一致。不参与计算的指令(死代码)不属于任何块 */
+enum minst_df_dir {
+    MINST_DF_FORWARD,
+    MINST_DF_BACKWARD,
+};
+
+/* 压缩存储的邻接表，块b的邻居是 to[start[b]..start[b+1]) */
+struct minst_df_edges {
+    int     *start;
+    int     *to;
+};
+
+struct minst_df_graph {
+    /* 块数 */
+    int     num;
+    /* 切块时的指令数 */
+    int     inst_num;
+    /* 块b的指令id按执行顺序放在 insts[inst_start[b]..inst_start[b+1]) */
+    int     *inst_start;
+    int     *insts;
+    /* 指令id -> 块号，不属于任何块的是-1 */
+    int     *inst_blk;
+
+    /* 块尾指令的后继边和块首指令的前驱边，以及它们的反向边，边不对称时前向问题
+    只看前驱边，后向问题只看后继边，和逐条指令的迭代一致 */
+    struct minst_df_edges succs;
+    struct minst_df_edges preds;
+    struct minst_df_edges succs_r;
+    struct minst_df_edges preds_r;
+
+    /* 逆后序 */
+    int     *rpo;
+};
+
+struct minst_df;
+
+/* 计算块b的 gen/kill 摘要，传进来时 gen/kill 都已经清零，块的传递函数是
+out = gen | (in & ~kill)，后向问题里 in/out 对调 */
+typedef void (*minst_df_summary)(struct minst_df *df, int b, unsigned int *gen, unsigned int *kill);
+
+struct minst_df {
+    struct minst_blk        *blk;
+    enum minst_df_dir       dir;
+    minst_df_summary        summary;
+    void                    *arg;
+
+    struct minst_df_graph   g;
+
+    /* 块级别的集合，每块一行，列数是 minst_df_solve 时传进来的 bits */
+    struct bitmat           in;
+    struct bitmat           out;
+    struct bitmat           gen;
+    struct bitmat           kill;
+
+    /* 增量更新，dirty 是摘要需要重算的块，touched 是上一次 minst_df_update 重新求解过的块 */
+    unsigned char           *dirty;
+    unsigned char           *touched;
+    int                     dirty_num;
+};
+
+/* SSA 形式的到达定值。
+
+按 REGS_NUM 以内的寄存器(和 blk->defs 一致)建SSA，每条定值指令在它影响的寄存器上产生一个
+新值，在迭代支配边界上插 phi，每条指令记下自己 use 的寄存器对应的值(use-def 链)。
+"哪些定值能到达这条指令"就是从这条指令上的值出发，沿着 phi 往回展开。
+
+结果要和按指令id做的到达定值完全一致，所以有两种额外的值：
+1. 指令定值了多个寄存器时，只有第一个寄存器 kill 别的定值(DEF)，其他寄存器上不 kill(MAYDEF)
+2. 指令 kill 的是 blk->defs[第一个定值寄存器] 里的所有指令，这些指令要是还定值了别的寄存器r，
+r 上的值也要把它们过滤掉(FILTER)
+
+minst_del_from_cfg 删指令不改变块之间的路径，不用重建：展开时删掉了的指令上的值当成不存在，
+直接看它之前的值，use-def 链(blk->du)在删的时候接好。改了边、加了指令、改了寄存器以后SSA
+失效(valid 为0)，由各个pass开头的 minst_blk_ssa_update 重建 */
+enum minst_ssa_kind {
+    MINST_SSA_UNDEF,
+    MINST_SSA_DEF,
+    MINST_SSA_MAYDEF,
+    MINST_SSA_FILTER,
+    MINST_SSA_PHI,
+};
+
+struct minst_ssa_val {
+    unsigned char   kind;
+    unsigned char   reg;
+    /* MAYDEF/FILTER 时 kill 掉的是同时定值了 kill_reg 的指令，0xff 是不 kill */
+    unsigned char   kill_reg;
+    /* DEF/MAYDEF/FILTER 是指令id，PHI 是块号 */
+    int             inst;
+    /* DEF/MAYDEF/FILTER 是之前的值，PHI 是参数在 ops 里的起点 */
+    int             prev;
+    /* PHI 的参数个数 */
+    int             num;
+};
+
+struct minst_ssa {
+    int                     valid;
+    /* 切块和前向数据流一样，看的是前驱边 */
+    struct minst_df_graph   g;
+    /* 块的直接支配者，-1 是虚拟根，所有DFS树的根都挂在虚拟根下面 */
+    int                     *idom;
+    int                     *root;
+    /* 支配边界 */
+    struct minst_df_edges   df;
+
+    /* 前 REGS_NUM 个值是各个寄存器的 UNDEF */
+    struct minst_ssa_val    *vals;
+    int                     val_num;
+    int                     val_cap;
+    int                     *ops;
+
+    /* 块b入口处寄存器r的值是 entry[b * REGS_NUM + r] */
+    int                     *entry;
+    /* 指令i上产生的值在 def_vals[def_start[i]..def_start[i+1])，指令i use 的寄存器的值在
+    use_vals[use_start[i]..use_start[i+1]) */
+    int                     *def_start;
+    int                     *def_vals;
+    int                     *use_start;
+    int                     *use_vals;
+    /* 指令在 g.insts 里的下标 */
+    int                     *inst_pos;
+    /* 建SSA时的快照：指令定值的第一个寄存器(-1没有定值，-2不参与计算)，以及 blk->defs 里
+    含有这条指令的寄存器掩码 */
+    int                     *gen_reg;
+    uint64_t                *dmask;
+
+    /* 展开查询用的临时空间 */
+    struct {
+        int         *gen;
+        int         *head;
+        int         cur;
+        int         *next;
+        uint64_t    *mask;
+        int         num;
+        int         cap;
+        int         *stack;
+        uint64_t    *stack_mask;
+        int         stack_cap;
+    } q;
+
+    /* 值编号，vn[v] 是值v的编号，编号相同的值在运行时一定相等；编号是常量的，vn_const[编号]
+    是一条对应的常量指令，否则是-1 */
+    int                     *vn;
+    int                     *vn_const;
+};
+
+/* def-use 链，从SSA展开出来，每条边是(定值指令, 使用指令, 寄存器)，同时挂在定值指令的
+使用者链表和使用指令的定值链表上，下标就是指令id。
+
+SSA重建以后失效，第一次查询的时候整体建。minst_del_from_cfg 删掉一条指令时，它的使用者
+重新沿着SSA接到到达的定值上，它有过滤的值时只能整体失效。改边以后链和SSA一样是旧的，
+跟着下一次SSA重建一起重建。
+摘掉的边 reg 是-1，next 指针不动，所以遍历时摘掉当前的边也能接着往下走 */
+struct minst_du_edge {
+    int     def;
+    int     use;
+    int     reg;
+    int     prev_use;
+    int     next_use;
+    int     prev_def;
+    int     next_def;
+};
+
+struct minst_du {
+    int                     valid;
+    /* 建链时的指令数，之后新建的指令上没有边 */
+    int                     num;
+    int                     cap;
+    /* 指令i作为定值的第一条边是 uses_head[i]，作为使用的第一条边是 defs_head[i]，-1是没有 */
+    int                     *uses_head;
+    int                     *defs_head;
+    /* 指令i上哪些寄存器的定值已经全部在链上了 */
+    uint64_t                *regs;
+    struct minst_du_edge    *edges;
+    int                     edge_num;
+    int                     edge_cap;
+};
+
+/* minst_cfg 粒度的支配树、后支配树和自然循环，节点编号就是 cfg->id。
+缓存在blk上，改边、新建cfg、删cfg以后失效，下次查询时重算 */
+struct minst_dom {
+    int                     valid;
+    int                     num;
+    /* cfg->end 的后继所在的cfg，死掉的cfg没有边 */
+    struct minst_df_edges   succs;
+    struct minst_df_edges   preds;
+    /* 从入口(allcfg[0])出发的逆后序，只含可达节点 */
+    int                     *rpo;
+    int                     rpo_num;
+
+    /* 直接支配者，入口是-1，不可达是-2 */
+    int                     *idom;
+    /* 直接后支配者，-1 是虚拟出口(所有funcend所在的cfg都连过去)，到不了出口的是-2 */
+    int                     *ipdom;
+    /* 支配树上的先序和后序编号，a 支配 b 当且仅当 a 的区间包含 b */
+    int                     *pre;
+    int                     *post;
+    int                     *ppre;
+    int                     *ppost;
+    /* 节点所在的最内层自然循环的循环头，-1 不在循环里；循环头的 loop_header 是自己 */
+    int                     *loop_header;
+    /* 循环头的外层循环头 */
+    int                     *loop_parent;
+    int                     *loop_depth;
+    /* 循环头上的回边数 */
+    int                     *latches;
+};
+
 struct minst_blk {
     char *funcname;
     void *emu;
@@ -47,22 +342,78 @@ struct minst_blk {
     /* 某寄存器所有use指令集合，数据为指令id */
     struct bitset     uses[REGS_NUM];
 
+    /* 到达定值分析的结果，每条指令一个 rset，下标就是指令id，个数(num)是分析开始时的
+    指令数，分析以后新建的指令取到的是空集合(empty)，用 minst_rd_in 这些宏访问。
+    trace 复制出来的指令很多，每个集合里的定值却很少，用 rset 比 n*n 的位矩阵省内存。
+
+    求解只算到块级别，指令上的行第一次被访问时才按块展开(expanded)，展开用的是求解时
+    保存下来的快照(def, defs)，所以之后IR再怎么改，取到的结果都和求解时一致 */
+    struct {
+        struct rset     *in;
+        struct rset     *out;
+        struct rset     *kills;
+        int             num;
+        struct rset     empty;
+
+        struct minst_df df;
+        /* 指令id -> 求解时定值的寄存器，-1是没有定值，-2是不参与计算(行保持为空) */
+        int             *def;
+        /* 求解时 blk->defs 的快照，LIVE_REGS_NUM 行 */
+        struct bitmat   defs;
+        unsigned char   *expanded;
+    } rd;
+
+    /* 活跃性分析 */
+    struct minst_df     live_df;
+
+    /* 分析过程里的到达定值查询都走SSA，到达定值矩阵只在打印指令时才算 */
+    struct minst_ssa    ssa;
+
+    /* def-use 链，用 minst_blk_du() 取 */
+    struct minst_du     du;
+
+    /* cfg 级别的支配树和循环，用 minst_blk_dom() 取 */
+    struct minst_dom    dom;
+
     struct dynarray     const_insts;
 
+    /* 条件常量传播进行中时指向它的状态，这时 minst_get_last_const_definition 直接读格 */
+    struct minst_sccp   *sccp;
+
     struct {
         /* 全局变量，判断是否需要进行活跃性分析 */
         unsigned need_liveness : 1;
     } flag;
 
+    /* minst，minst_node，minst_cfg，minst_temp 都从这里分配，minst_blk_uninit 时整体释放 */
+    struct marena       arena;
+    /* 被删掉的边节点挂在这里，下次加边时优先复用 */
+    struct minst_node   *free_nodes;
+
+    /* 查询用的临时集合池，按栈的方式借还(minst_blk_scratch_get/put)。集合本身从 arena 里
+    分配，数据的内存一直留着复用，minst_blk_uninit 时才释放 */
+    struct {
+        struct bitset   **sets;
+        int             top;
+        int             num;
+    } scratch;
+
     struct minst    *trace[2048];
     int trace_top;
 
+    /* 新生成的指令的二进制编码都放在这里，按块分配，块不会移动，所以 minst->addr
+    可以一直指向里面 */
     struct {
-        unsigned char   data[8 * KB];
+        struct dynarray chunks;
+        /* 最后一块已经用掉的字节数 */
         int             len;
     } text_sec;
 
     minst_parse_callback minst_do;
+    minst_bcond_callback bcond_do;
+    minst_pure_callback pure_do;
+    minst_fields_callback fields_do;
+    minst_rename_callback rename_do;
 
     struct {
         struct minst_cfg    *cfg;
@@ -119,18 +470,13 @@ struct minst {
     unsigned char *addr;
     int len;
 
-    int id;
-    struct bitset use;
-    struct bitset def;
-    struct bitset in;
-    struct bitset out;
-
-    struct bitset rd_in;
-    struct bitset rd_out;
-    struct bitset kills;
+    struct minst_blk *blk;
 
-    struct bitset t_in;
-    struct bitset t_out;
+    int id;
+    struct live_regs use;
+    struct live_regs def;
+    struct live_regs in;
+    struct live_regs out;
 
     struct minst_node preds;
     struct minst_node succs;
@@ -172,6 +518,8 @@ struct minst {
         unsigned def_oper : 1;
         unsigned callee_restore : 1;
         unsigned like_it : 1;
+        /* ctx 已经解码过，并且设置过寄存器的def/use */
+        unsigned decoded : 1;
     } flag;
 
     unsigned long host_addr;            // jump address, need be fixed in second pass
@@ -186,6 +534,8 @@ struct minst {
 
     /* 调用哪个reg_node去解析内容 */
     void *reg_node;
+    /* 第一次执行时解码出来的指令上下文，minst_change以后失效 */
+    struct arm_inst_ctx ctx;
 
     short ld;
     short ld2;
@@ -197,25 +547,25 @@ struct minst {
 
 
 #define live_def_set(blk, reg)       do { \
-        bitset_set(&minst->def, reg, 1); \
+        live_regs_set(&minst->def, reg, 1); \
         if ((reg < REGS_NUM) && (reg > -1)) \
             bitset_set(&((blk)->defs[reg]), minst->id, 1); \
     } while (0)
 
 #define live_def_set1(blk, m, reg)       do { \
-        bitset_set(&m->def, reg, 1); \
+        live_regs_set(&m->def, reg, 1); \
         if ((reg < REGS_NUM) && (reg > -1)) \
             bitset_set(&((blk)->defs[reg]), m->id, 1); \
     } while (0)
 
 #define live_use_set(blk, reg)       do { \
-        bitset_set(&minst->use, reg, 1); \
+        live_regs_set(&minst->use, reg, 1); \
         if ((reg < REGS_NUM) && (reg > -1)) \
             bitset_set(&((blk)->uses[reg]), minst->id, 1); \
     } while (0)
 
 #define live_use_clear(blk, reg)    do { \
-        bitset_set(&minst->use, reg, 0); \
+        live_regs_set(&minst->use, reg, 0); \
         if ((reg < REGS_NUM) && (reg > -1)) \
             bitset_set(&((blk)->uses[reg]), minst->id, 0); \
     } while (0)
@@ -242,8 +592,10 @@ void                minst_blk_add_funcend(struct minst_blk *blk, struct minst *m
 
 struct minst*       minst_new(struct minst_blk *blk, unsigned char *code, int len, void *reg_node);
 struct minst*       minst_new_copy(struct minst_cfg *cfg, struct minst *src);
+/* 在 text_sec 里分配 len 字节给新指令，code 为NULL时不拷贝，由调用者往 minst->addr 里直接写编码 */
 struct minst*       minst_new_t(struct minst_cfg *cfg, enum minst_type type, void *reg_node, unsigned char *code, int len);
 struct minst*       minst_change(struct minst *m, enum minst_type type, void *reg_node, unsigned char *code, int len);
+unsigned char*      minst_blk_text_alloc(struct minst_blk *blk, int len);
 void                minst_delete(struct minst *inst);
 void                minst_restore(struct minst *minst);
 int                 minst_succs_count(struct minst *minst);
@@ -318,14 +670,65 @@ void                minst_blk_live_epilogue_add(struct minst_blk *blk);
 
 int                 minst_blk_is_on_start_unique_path(struct minst_blk *blk, struct minst *def, struct minst *use);
 
+void                minst_df_init(struct minst_df *df, enum minst_df_dir dir, minst_df_summary summary, void *arg);
+void                minst_df_uninit(struct minst_df *df);
+/* 重新切块并求解到不动点，bits 是集合的位数 */
+int                 minst_df_solve(struct minst_df *df, struct minst_blk *blk, int bits);
+/* 增量求解，只适用于上次求解以后IR的改动只有 minst_del_from_cfg 的情况。被删的指令
+还留在原来的块里当作空指令，minst_del_from_cfg 会把它所在的块标脏，update 只重算脏块
+和依赖它们的块，返回重算的块数 */
+void                minst_df_dirty(struct minst_df *df, struct minst *m);
+int                 minst_df_update(struct minst_df *df);
+
 /* */
 int                 minst_blk_liveness_calc(struct minst_blk *blk);
+int                 minst_blk_liveness_update(struct minst_blk *blk);
 
 /* 死代码删除 */
 int                 minst_blk_dead_code_elim(struct minst_blk *blk);
 
 /* 生成到达定值, generate reaching definitions */
 int                 minst_blk_gen_reaching_definitions(struct minst_blk *blk);
+/* 建SSA，查询的结果是建的时候的快照加上之后删掉的指令，之后新建的指令查不到任何定值 */
+int                 minst_blk_ssa_build(struct minst_blk *blk);
+void                minst_blk_ssa_uninit(struct minst_blk *blk);
+/* SSA 失效了才重建，没失效只重新编号，返回是否重建了 */
+int                 minst_blk_ssa_update(struct minst_blk *blk);
+#define minst_blk_ssa_invalidate(b)         ((b)->ssa.valid = 0)
+/* 到达指令m入口、对寄存器reg定值的指令集合，写到defs里，返回个数。和
+minst_rd_in(m) & blk->defs[reg] 的结果一样 */
+int                 minst_get_reaching_defs(struct minst_blk *blk, struct minst *m, int reg, struct bitset *defs);
+
+/* 借一个清空的临时集合，长度至少是当前的指令数；必须按借的相反顺序还 */
+struct bitset*      minst_blk_scratch_get(struct minst_blk *blk);
+void                minst_blk_scratch_put(struct minst_blk *blk, struct bitset *bs);
+
+/* def-use 链，缓存失效了就从SSA重建 */
+struct minst_du*    minst_blk_du(struct minst_blk *blk);
+void                minst_blk_du_uninit(struct minst_blk *blk);
+#define minst_blk_du_invalidate(b)          ((b)->du.valid = 0)
+/* 遍历定值指令m的使用者/使用指令m的定值，e 是边在 du->edges 里的下标，摘掉的边 reg 是-1 */
+#define minst_du_uses_foreach(du, m, e) \
+    for (e = ((du)->valid && ((m)->id < (du)->num)) ? (du)->uses_head[(m)->id] : -1; e >= 0; e = (du)->edges[e].next_use)
+#define minst_du_defs_foreach(du, m, e) \
+    for (e = ((du)->valid && ((m)->id < (du)->num)) ? (du)->defs_head[(m)->id] : -1; e >= 0; e = (du)->edges[e].next_def)
+
+/* cfg 的支配树、后支配树和循环，缓存失效了就重算 */
+struct minst_dom*   minst_blk_dom(struct minst_blk *blk);
+void                minst_blk_dom_uninit(struct minst_blk *blk);
+#define minst_blk_dom_invalidate(b)         ((b)->dom.valid = 0)
+int                 minst_cfg_dominates(struct minst_cfg *a, struct minst_cfg *b);
+int                 minst_cfg_postdominates(struct minst_cfg *a, struct minst_cfg *b);
+int                 minst_cfg_is_reachable(struct minst_cfg *cfg);
+/* 返回cfg所在最内层循环的循环头，不在循环里返回NULL */
+struct minst_cfg*   minst_cfg_loop_header(struct minst_cfg *cfg);
+int                 minst_cfg_loop_depth(struct minst_cfg *cfg);
+
+/* 返回指令m在到达定值结果rows里的那个集合，还没展开的块先展开 */
+struct rset*        minst_rd_row(struct minst *m, struct rset *rows);
+#define minst_rd_in(m)                      minst_rd_row(m, (m)->blk->rd.in)
+#define minst_rd_out(m)                     minst_rd_row(m, (m)->blk->rd.out)
+#define minst_kills(m)                      minst_rd_row(m, (m)->blk->rd.kills)
 
 int                 minst_blk_value_numbering(struct minst_blk *blk);
 
@@ -341,7 +744,14 @@ mov r5, r6
 */
 int                 minst_blk_copy_propagation(struct minst_blk *blk);
 
-int                 minst_blk_regalloc(struct minst_blk *blk);
+/* mov 合并。按到达定值把同一个寄存器上相连的定值和使用合成web，在cfg的逆后序上给每个web
+算一个活跃区间，按区间起点扫描，区间不冲突时把 mov 两边的web换到同一个 r0-r12 上，两边变成
+同一个寄存器的 mov 直接删掉，返回删掉的 mov 条数。
+
+这不是寄存器分配：web 只会换到另一个已经在用的寄存器上，栈上的临时变量不会提到寄存器里。
+和 prologue/epilogue 相连的、有指令没法重新编码的web固定在原来的寄存器上，bl 按调用约定
+破坏 r0-r3,r12，函数自己没有改过的寄存器不拿来用 */
+int                 minst_blk_coalesce(struct minst_blk *blk);
 
 /* 指令乱序，为接下去的寄存器分配优化做准备
 
@@ -373,6 +783,8 @@ label_1:
 label_1:
 
     这样不用进行寄存器分配，只是做一些简单的复写传播之类的优化就能干掉一些mov指令了
+
+    只沉 pure_do 认可的单定值纯运算，只往前驱唯一的后继里插，不切边；返回下沉的指令数
 */
 int                 minst_blk_out_of_order(struct minst_blk *blk);
 
@@ -402,8 +814,12 @@ int                 minst_cfg_inst_count(struct minst_cfg *cfg);
 */
 struct minst*       minst_cfg_apsr_get_overdefine_reg(struct minst_cfg *cfg, int *reg);
 
-/* 条件常数传播 */
+/* 稀疏条件常量传播(SCCP)，SSA值上的格加上可执行边，SSA/CFG工作表跑一遍到不动点，最后改掉
+只剩一个方向的条件跳转。要求已经是常量模式，返回是否有新的常量或者删了边 */
 int                 minst_conditional_const_propagation(struct minst_blk *blk);
+/* 指令m入口处reg可能取到的常量定值放进 defs，返回个数，有不是常量的定值返回-1。
+常量传播过程中只沿着可执行的边找，还没算出来的定值不算在里面 */
+int                 minst_get_const_defs(struct minst_blk *blk, struct minst *m, int reg, struct dynarray *defs);
 
 struct minst*       minst_get_last_const_definition(struct minst_blk *blk, struct minst *minst, int regm);
 /* 获取从minst指令往前的，对regm的定义
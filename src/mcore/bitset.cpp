@@ -1,6 +1,7 @@
 ﻿
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "bitset.h"
 #include "mtime_ex.h"
 #include "print_util.h"
@@ -10,6 +11,9 @@ static int      bitset__expand(struct bitset *bs, int len)
     int len4, new_len = len;
     unsigned int *p;
 
+    if (bs->ref)
+        return -1;
+
     if (len <= bs->len4 * 32) {
         bs->len = len;
         bs->siz4 = (bs->len + 31) / 32;
@@ -77,7 +81,8 @@ int             bitset_set(struct bitset *bset, int bit, int val)
         return 0;
 
     if (bit >= bset->len) {
-        bitset__expand(bset, bit + 1);
+        if (bitset__expand(bset, bit + 1))
+            return -1;
     }
 
     val = !!val;
@@ -111,54 +116,284 @@ void            bitset_clear(struct bitset *bs)
 
 void            bitset_reset(struct bitset *bs)
 {
-    if (bs->data)
+    if (bs->data && !bs->ref)
         free(bs->data);
 
     memset(bs, 0, sizeof (bs[0]));
 }
 
-struct bitset*  bitset_or(struct bitset *dst, struct bitset *src)
+/* 按int数组做的运算内核，n 是int数。默认的实现两个int拼成64位一起算，x86上CPU支持
+AVX2的话一次算8个int，第一次用的时候按CPU选一套 */
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#   define BITSET_X86       1
+#   include <immintrin.h>
+#   if defined(_MSC_VER)
+#       include <intrin.h>
+#       define BITSET_AVX2
+#   else
+#       define BITSET_AVX2  __attribute__((target("avx2")))
+#   endif
+#endif
+
+typedef unsigned long long  bitset_u8;
+
+/* data 只保证int对齐，用memcpy读写，编译器会优化成一条指令 */
+static inline bitset_u8     bitset__ld8(const unsigned int *p)
+{
+    bitset_u8 v;
+
+    memcpy(&v, p, sizeof (v));
+    return v;
+}
+
+static inline void          bitset__st8(unsigned int *p, bitset_u8 v)
+{
+    memcpy(p, &v, sizeof (v));
+}
+
+struct bitset_kern
 {
+    void    (*or_)(unsigned int *dst, const unsigned int *src, int n);
+    void    (*and_)(unsigned int *dst, const unsigned int *src, int n);
+    void    (*sub)(unsigned int *dst, const unsigned int *src, int n);
+    int     (*equal)(const unsigned int *a, const unsigned int *b, int n);
+    int     (*or_andnot)(unsigned int *dst, const unsigned int *a, const unsigned int *b, const unsigned int *c, int n);
+};
+
+static void     bitset__or_64(unsigned int *dst, const unsigned int *src, int n)
+{
+    bitset_u8 v;
     int i;
 
-    if (dst->len4 != src->len4) {
-        bitset__expand((dst->len > src->len) ? src:dst, (dst->len > src->len)?dst->len:src->len);
+    for (i = 0; i + 2 <= n; i += 2) {
+        v = bitset__ld8(dst + i) | bitset__ld8(src + i);
+        bitset__st8(dst + i, v);
     }
+    for (; i < n; i++)
+        dst[i] |= src[i];
+}
 
-    for (i = 0; i < dst->siz4; i++) {
-        dst->data[i] |= src->data[i];
+static void     bitset__and_64(unsigned int *dst, const unsigned int *src, int n)
+{
+    bitset_u8 v;
+    int i;
+
+    for (i = 0; i + 2 <= n; i += 2) {
+        v = bitset__ld8(dst + i) & bitset__ld8(src + i);
+        bitset__st8(dst + i, v);
     }
+    for (; i < n; i++)
+        dst[i] &= src[i];
+}
 
-    return dst;
+static void     bitset__sub_64(unsigned int *dst, const unsigned int *src, int n)
+{
+    bitset_u8 v;
+    int i;
+
+    for (i = 0; i + 2 <= n; i += 2) {
+        v = bitset__ld8(dst + i) & ~bitset__ld8(src + i);
+        bitset__st8(dst + i, v);
+    }
+    for (; i < n; i++)
+        dst[i] &= ~src[i];
 }
 
-struct bitset*  bitset_clone(struct bitset *dst, struct bitset *src)
+static int      bitset__equal_64(const unsigned int *a, const unsigned int *b, int n)
 {
+    bitset_u8 v;
     int i;
 
-    if (dst->len4 != src->len4) {
-        bitset__expand((dst->len > src->len) ? src:dst, (dst->len > src->len)?dst->len:src->len);
+    for (i = 0; i + 2 <= n; i += 2) {
+        v = bitset__ld8(a + i);
+        if (v != bitset__ld8(b + i))
+            return 0;
+    }
+    for (; i < n; i++) {
+        if (a[i] != b[i])
+            return 0;
     }
 
-    for (i = 0; i < dst->siz4; i++) {
-        dst->data[i] = src->data[i];
+    return 1;
+}
+
+static int      bitset__or_andnot_64(unsigned int *dst, const unsigned int *a, const unsigned int *b, const unsigned int *c, int n)
+{
+    bitset_u8 v, changed = 0;
+    unsigned int v4;
+    int i;
+
+    for (i = 0; i + 2 <= n; i += 2) {
+        v = bitset__ld8(a + i);
+        v |= bitset__ld8(b + i) & ~bitset__ld8(c + i);
+        changed |= v ^ bitset__ld8(dst + i);
+        bitset__st8(dst + i, v);
+    }
+    for (; i < n; i++) {
+        v4 = a[i] | (b[i] & ~c[i]);
+        changed |= v4 ^ dst[i];
+        dst[i] = v4;
     }
 
-    return dst;
+    return !!changed;
 }
 
-struct bitset*  bitset_and(struct bitset *dst, struct bitset *src)
+static const struct bitset_kern bitset__kern_64 = {
+    bitset__or_64, bitset__and_64, bitset__sub_64,
+    bitset__equal_64, bitset__or_andnot_64
+};
+
+#if defined(BITSET_X86)
+#define bitset__ld32(p)     _mm256_loadu_si256((const __m256i *)(p))
+#define bitset__st32(p, v)  _mm256_storeu_si256((__m256i *)(p), v)
+
+static BITSET_AVX2 void bitset__or_avx2(unsigned int *dst, const unsigned int *src, int n)
 {
     int i;
 
-    if (dst->len != src->len) {
-        bitset__expand((dst->len > src->len) ? src:dst, (dst->len > src->len)?dst->len:src->len);
+    for (i = 0; i + 8 <= n; i += 8)
+        bitset__st32(dst + i, _mm256_or_si256(bitset__ld32(dst + i), bitset__ld32(src + i)));
+
+    bitset__or_64(dst + i, src + i, n - i);
+}
+
+static BITSET_AVX2 void bitset__and_avx2(unsigned int *dst, const unsigned int *src, int n)
+{
+    int i;
+
+    for (i = 0; i + 8 <= n; i += 8)
+        bitset__st32(dst + i, _mm256_and_si256(bitset__ld32(dst + i), bitset__ld32(src + i)));
+
+    bitset__and_64(dst + i, src + i, n - i);
+}
+
+static BITSET_AVX2 void bitset__sub_avx2(unsigned int *dst, const unsigned int *src, int n)
+{
+    int i;
+
+    /* andnot(x, y) = ~x & y */
+    for (i = 0; i + 8 <= n; i += 8)
+        bitset__st32(dst + i, _mm256_andnot_si256(bitset__ld32(src + i), bitset__ld32(dst + i)));
+
+    bitset__sub_64(dst + i, src + i, n - i);
+}
+
+static BITSET_AVX2 int  bitset__equal_avx2(const unsigned int *a, const unsigned int *b, int n)
+{
+    __m256i x;
+    int i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        x = _mm256_xor_si256(bitset__ld32(a + i), bitset__ld32(b + i));
+        if (!_mm256_testz_si256(x, x))
+            return 0;
     }
 
-    for (i = 0; i < dst->siz4; i++) {
-        dst->data[i] &= src->data[i];
+    return bitset__equal_64(a + i, b + i, n - i);
+}
+
+static BITSET_AVX2 int  bitset__or_andnot_avx2(unsigned int *dst, const unsigned int *a, const unsigned int *b, const unsigned int *c, int n)
+{
+    __m256i v, changed = _mm256_setzero_si256();
+    int i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        v = _mm256_or_si256(bitset__ld32(a + i), _mm256_andnot_si256(bitset__ld32(c + i), bitset__ld32(b + i)));
+        changed = _mm256_or_si256(changed, _mm256_xor_si256(v, bitset__ld32(dst + i)));
+        bitset__st32(dst + i, v);
+    }
+
+    return bitset__or_andnot_64(dst + i, a + i, b + i, c + i, n - i) | !_mm256_testz_si256(changed, changed);
+}
+
+static const struct bitset_kern bitset__kern_avx2 = {
+    bitset__or_avx2, bitset__and_avx2, bitset__sub_avx2,
+    bitset__equal_avx2, bitset__or_andnot_avx2
+};
+
+static int      bitset__cpu_avx2(void)
+{
+#if defined(_MSC_VER)
+    int info[4];
+
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return 0;
+
+    /* OSXSAVE + AVX，并且系统保存了 ymm 寄存器 */
+    __cpuid(info, 1);
+    if (((info[2] >> 27) & 3) != 3)
+        return 0;
+    if ((_xgetbv(0) & 6) != 6)
+        return 0;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] >> 5) & 1;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+static const struct bitset_kern *bitset__k;
+
+/* 多线程同时初始化也没关系，大家选出来的都是同一套 */
+static const struct bitset_kern*    bitset__kern(void)
+{
+    if (!bitset__k) {
+#if defined(BITSET_X86)
+        bitset__k = bitset__cpu_avx2() ? &bitset__kern_avx2 : &bitset__kern_64;
+#else
+        bitset__k = &bitset__kern_64;
+#endif
     }
 
+    return bitset__k;
+}
+
+/* 二元运算只会扩展dst，不会修改src，src比dst短的部分当0处理，
+dst是视图时不扩展，超出部分直接丢掉
+
+@return     dst 和 src 都有的int数 */
+static int      bitset__fit(struct bitset *dst, struct bitset *src)
+{
+    if (src->len > dst->len)
+        bitset__expand(dst, src->len);
+
+    return (dst->siz4 < src->siz4) ? dst->siz4 : src->siz4;
+}
+
+struct bitset*  bitset_or(struct bitset *dst, struct bitset *src)
+{
+    int n = bitset__fit(dst, src);
+
+    bitset__kern()->or_(dst->data, src->data, n);
+
+    return dst;
+}
+
+struct bitset*  bitset_clone(struct bitset *dst, struct bitset *src)
+{
+    int n = bitset__fit(dst, src);
+
+    if (n > 0)
+        memcpy(dst->data, src->data, n * sizeof (dst->data[0]));
+    if (dst->siz4 > n)
+        memset(dst->data + n, 0, (dst->siz4 - n) * sizeof (dst->data[0]));
+
+    return dst;
+}
+
+struct bitset*  bitset_and(struct bitset *dst, struct bitset *src)
+{
+    int n = bitset__fit(dst, src);
+
+    bitset__kern()->and_(dst->data, src->data, n);
+
+    if (dst->siz4 > n)
+        memset(dst->data + n, 0, (dst->siz4 - n) * sizeof (dst->data[0]));
+
     return dst;
 }
 
@@ -175,31 +410,37 @@ struct bitset*  bitset_not(struct bitset *dst)
 
 struct bitset*  bitset_sub(struct bitset *dst, struct bitset *src)
 {
-    int i, a, b;
-
-    if (dst->len4 != src->len4) {
-        bitset__expand((dst->len > src->len) ? src:dst, (dst->len > src->len)?dst->len:src->len);
-    }
+    int n = bitset__fit(dst, src);
 
-    for (i = 0; i < dst->siz4; i++) {
-        a = dst->data[i];
-        b = src->data[i];
-        dst->data[i] = ~(a & b) & a;
-    }
+    bitset__kern()->sub(dst->data, src->data, n);
 
     return dst;
 }
 
+void            bitset_words_or(unsigned int *dst, const unsigned int *src, int n)
+{
+    bitset__kern()->or_(dst, src, n);
+}
+
+int             bitset_words_or_andnot(unsigned int *dst, const unsigned int *a, const unsigned int *b, const unsigned int *c, int n)
+{
+    return bitset__kern()->or_andnot(dst, a, b, c, n);
+}
+
 int             bitset_is_equal(struct bitset *dst, struct bitset *src)
 {
-    int i;
+    int i, n = (dst->siz4 < src->siz4) ? dst->siz4 : src->siz4;
 
-    if (dst->len4 != src->len4) {
-        bitset__expand((dst->len > src->len) ? src:dst, (dst->len > src->len)?dst->len:src->len);
+    if (!bitset__kern()->equal(dst->data, src->data, n))
+        return 0;
+
+    for (i = n; i < dst->siz4; i++) {
+        if (dst->data[i])
+            return 0;
     }
 
-    for (i = 0; i < dst->siz4; i++) {
-        if (dst->data[i] != src->data[i])
+    for (i = n; i < src->siz4; i++) {
+        if (src->data[i])
             return 0;
     }
 
@@ -218,47 +459,81 @@ int             bitset_is_empty(struct bitset *bs)
     return 1;
 }
 
+/* 最低位的1的位置和1的个数，v 不能是0 */
+#if defined(_MSC_VER)
+#include <intrin.h>
+
+static inline int bitset__ctz(unsigned int v)
+{
+    unsigned long i;
+
+    _BitScanForward(&i, v);
+    return (int)i;
+}
+
+static inline int bitset__popcount(unsigned int v)
+{
+    v = v - ((v >> 1) & 0x55555555);
+    v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+    v = (v + (v >> 4)) & 0x0F0F0F0F;
+
+    return (int)((v * 0x01010101) >> 24);
+}
+#else
+#define bitset__ctz(v)          __builtin_ctz(v)
+#define bitset__popcount(v)     __builtin_popcount(v)
+#endif
+
 int         bitset_next_bit_pos(struct bitset *bs, int pos)
 {
-    int i, j, k;
+    unsigned int w;
+    int i, k;
+
     if (pos >= bs->len || pos < 0)
         return -1;
 
-    while (pos < bs->len) {
-        i = pos / 32;
-        if (!bs->data[i])
-            pos = (i + 1) * 32;
-        else {
-            for (j = pos % 32; j < 32; j++) {
-                if (bs->data[i] & (1 << j))
-                    return ((k = (i * 32 + j)) >= bs->len) ? -1:k;
-            }
-
-            pos = (i + 1) * 32;
-        }
+    i = pos / 32;
+    w = bs->data[i] & (~0u << (pos % 32));
+    while (!w) {
+        if (++i >= bs->siz4)
+            return -1;
+        w = bs->data[i];
     }
 
-    return -1;
+    return ((k = (i * 32 + bitset__ctz(w))) >= bs->len) ? -1:k;
 }
 
-static inline int bit_count(int v)
+int             bitset_bits(struct bitset *bs, int pos, int *buf, int n)
 {
-    int c;
+    unsigned int w;
+    int i, k, num = 0;
 
-    c = (v & 0x55555555) + ((v >> 1) & 0x55555555);
-    c = (c & 0x33333333) + ((c >> 2) & 0x33333333);
-    c = (c & 0x0F0F0F0F) + ((c >> 4) & 0x0F0F0F0F);
-    c = (c & 0x00FF00FF) + ((c >> 8) & 0x00FF00FF);
-    c = (c & 0x0000FFFF) + ((c >> 16) & 0x0000FFFF);
+    if (pos >= bs->len || pos < 0 || n <= 0)
+        return 0;
 
-    return c;
+    i = pos / 32;
+    w = bs->data[i] & (~0u << (pos % 32));
+    for (;;) {
+        /* 每次取最低位的1，然后清掉它 */
+        for (; w; w &= w - 1) {
+            if ((k = i * 32 + bitset__ctz(w)) >= bs->len)
+                return num;
+            buf[num++] = k;
+            if (num == n)
+                return num;
+        }
+
+        if (++i >= bs->siz4)
+            return num;
+        w = bs->data[i];
+    }
 }
 
 int             bitset_count(struct bitset *bs)
 {
     int c = 0, i;
     for (i = 0; i < bs->len4; i++)
-        c += bit_count(bs->data[i]);
+        c += bitset__popcount(bs->data[i]);
 
     return c;
 }
@@ -279,3 +554,55 @@ void            bitset_dump(struct bitset *bs)
     printf("}");
 }
 
+struct bitmat*  bitmat_init(struct bitmat *m, int rows, int cols)
+{
+    int i;
+
+    memset(m, 0, sizeof (m[0]));
+    m->rows = rows;
+    m->cols = cols;
+    m->cols4 = (cols + 31) / 32;
+    m->empty.ref = 1;
+
+    if (!rows)
+        return m;
+
+    m->data = (unsigned int *)calloc((size_t)rows * m->cols4 + 1, sizeof (m->data[0]));
+    m->views = (struct bitset *)calloc(rows, sizeof (m->views[0]));
+    if (!m->data || !m->views) {
+        bitmat_uninit(m);
+        return NULL;
+    }
+
+    for (i = 0; i < rows; i++) {
+        m->views[i].len = cols;
+        m->views[i].len4 = m->views[i].siz4 = m->cols4;
+        m->views[i].data = bitmat_row_data(m, i);
+        m->views[i].ref = 1;
+    }
+
+    return m;
+}
+
+void            bitmat_uninit(struct bitmat *m)
+{
+    if (m->data)    free(m->data);
+    if (m->views)   free(m->views);
+
+    memset(m, 0, sizeof (m[0]));
+    m->empty.ref = 1;
+}
+
+void            bitmat_clear(struct bitmat *m)
+{
+    if (m->data)
+        memset(m->data, 0, (size_t)m->rows * m->cols4 * sizeof (m->data[0]));
+}
+
+struct bitset*  bitmat_row(struct bitmat *m, int row)
+{
+    if ((row < 0) || (row >= m->rows))
+        return &m->empty;
+
+    return &m->views[row];
+}
@@ -14,6 +14,22 @@ struct bitset
     int len4;
     int siz4;
     unsigned int *data;
+    /* 视图，data不属于自己(比如指向 bitmat 的某一行)，不能扩展也不能释放 */
+    int ref;
+};
+
+/* 行优先的位矩阵，每行是一个定长的位集合，所有行放在一块连续内存里。
+每行都有一个对应的 bitset 视图，可以直接传给 bitset_xxx 使用 */
+struct bitmat
+{
+    int rows;
+    int cols;
+    /* 每行占用的int数 */
+    int cols4;
+    unsigned int *data;
+    struct bitset *views;
+    /* 越界访问时返回的空集合 */
+    struct bitset empty;
 };
 
 #define BITSET_INIT(a)      struct bitset a = {0}
@@ -42,11 +58,25 @@ struct bitset
     /* dst = dst - src*/
     struct bitset*  bitset_sub(struct bitset *dst, struct bitset *src);
     int             bitset_is_equal(struct bitset *lhs, struct bitset *src);
+    /* 直接在int数组上算，给 bitmat 的行用，n 是int数 */
+    void            bitset_words_or(unsigned int *dst, const unsigned int *src, int n);
+    int             bitset_words_or_andnot(unsigned int *dst, const unsigned int *a, const unsigned int *b, const unsigned int *c, int n);
     int             bitset_is_empty(struct bitset *bs);
     int             bitset_next_bit_pos(struct bitset *bs, int pos);
+    /* 把从pos开始的置位的位置按顺序写到buf里，最多写n个，返回写了几个。
+    写满n个时从 buf[n-1]+1 开始接着取 */
+    int             bitset_bits(struct bitset *bs, int pos, int *buf, int n);
     int             bitset_count(struct bitset *bs);
     void            bitset_dump(struct bitset *bs);
 
+    struct bitmat*  bitmat_init(struct bitmat *m, int rows, int cols);
+    void            bitmat_uninit(struct bitmat *m);
+    void            bitmat_clear(struct bitmat *m);
+    /* 返回第row行的视图，越界时返回空集合 */
+    struct bitset*  bitmat_row(struct bitmat *m, int row);
+
+#define bitmat_row_data(m, r)       ((m)->data + (size_t)(r) * (m)->cols4)
+
 #define bitset_foreach(bs, _i) \
     for (_i = bitset_next_bit_pos(bs, 0); _i >= 0; _i = bitset_next_bit_pos(bs, _i + 1)) 
 
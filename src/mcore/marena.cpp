@@ -0,0 +1,57 @@
+﻿
+#include <stdlib.h>
+#include <string.h>
+#include "dynarray.h"
+#include "marena.h"
+
+#define MARENA_ALIGN(s)         (((s) + 7) & ~7)
+#define MARENA_BLOCK_DEFAULT    (64 * 1024)
+
+void    marena_init(struct marena *arena, int block_size)
+{
+    memset(arena, 0, sizeof (arena[0]));
+    arena->block_size = (block_size > 0) ? block_size : MARENA_BLOCK_DEFAULT;
+}
+
+void    marena_uninit(struct marena *arena)
+{
+    int i;
+
+    for (i = 0; i < arena->blocks.len; i++)
+        free(arena->blocks.ptab[i]);
+    dynarray_reset(&arena->blocks);
+
+    arena->cur = NULL;
+    arena->left = 0;
+}
+
+void*   marena_alloc(struct marena *arena, int size)
+{
+    unsigned char *p;
+    int bsize;
+
+    size = MARENA_ALIGN(size);
+    if (size > arena->left) {
+        if (!arena->block_size)
+            arena->block_size = MARENA_BLOCK_DEFAULT;
+
+        /* 超过块大小的对象单独占一块 */
+        bsize = (size > arena->block_size) ? size : arena->block_size;
+        p = (unsigned char *)calloc(1, bsize);
+        if (!p)
+            return NULL;
+
+        dynarray_add(&arena->blocks, p);
+        if (bsize == size)
+            return p;
+
+        arena->cur = p;
+        arena->left = bsize;
+    }
+
+    p = arena->cur;
+    arena->cur += size;
+    arena->left -= size;
+
+    return p;
+}
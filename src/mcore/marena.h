@@ -0,0 +1,27 @@
+﻿#ifndef __marena_h__
+#define __marena_h__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /* 简单的bump分配器，内存按块申请，只能整体释放，适合生命周期相同的大量小对象 */
+    struct marena
+    {
+        /* 所有块，释放时一次性free掉 */
+        struct dynarray blocks;
+        unsigned char   *cur;
+        int             left;
+        int             block_size;
+    };
+
+    void    marena_init(struct marena *arena, int block_size);
+    void    marena_uninit(struct marena *arena);
+    /* 返回清零过的内存，8字节对齐 */
+    void*   marena_alloc(struct marena *arena, int size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -30,7 +30,9 @@ extern "C" {
 #include "mcore/pgm.h"
 #include "mcore/rbtree.h"
 #include "mcore/dynarray.h"
+#include "mcore/marena.h"
 #include "mcore/bitset.h"
+#include "mcore/rset.h"
 #include "mcore/queue.h"
 #include "mcore/graph.h"
 #include "mcore/image.h"
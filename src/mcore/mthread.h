@@ -7,9 +7,40 @@ extern "C" {
 #endif/* defined(__cplusplus) */
 
 #if defined(_MSC_VER)
+#include <windows.h>
+
+typedef HANDLE                  mthread_t;
+typedef DWORD                   mthread_ret;
+#define MTHREAD_API             WINAPI
+
 #define mthread_sleep(ms)       Sleep(ms)
+/* 成功返回0，失败返回-1 */
+#define mthread_create(pt, func, arg)   ((*(pt) = CreateThread(NULL, 0, func, arg, 0, NULL)) ? 0 : -1)
+#define mthread_join(t)         do { WaitForSingleObject(t, INFINITE); CloseHandle(t); } while (0)
+
+static __inline int mthread_cpu_num(void)
+{
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return (int)si.dwNumberOfProcessors;
+}
 #else
+#include <pthread.h>
+#include <unistd.h>
+
+typedef pthread_t               mthread_t;
+typedef void*                   mthread_ret;
+#define MTHREAD_API
+
 #define mthread_sleep(ms)       usleep(ms * 1000)
+#define mthread_create(pt, func, arg)   (pthread_create(pt, NULL, func, arg) ? -1 : 0)
+#define mthread_join(t)         pthread_join(t, NULL)
+
+static inline int mthread_cpu_num(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? (int)n : 1;
+}
 #endif
 
 #if defined(__cplusplus)
@@ -77,6 +77,17 @@ unsigned int mtime_tick()
     return GetTickCount();
 }
 
+unsigned long long mtime_ns()
+{
+    LARGE_INTEGER freq, cnt;
+
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&cnt);
+
+    return (unsigned long long)(cnt.QuadPart / freq.QuadPart) * 1000000000ull
+        + (unsigned long long)(cnt.QuadPart % freq.QuadPart) * 1000000000ull / freq.QuadPart;
+}
+
 #else
 char *mtime2s(char *buf)
 {
@@ -107,4 +118,11 @@ unsigned int mtime_tick()
     clock_gettime(CLOCK_MONOTONIC, &t);
     return (unsigned int)(t.tv_nsec / 1000000);
 }
+
+unsigned long long mtime_ns()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (unsigned long long)t.tv_sec * 1000000000ull + t.tv_nsec;
+}
 #endif
@@ -11,6 +11,8 @@ extern "C" {
     wchar_t *mtime2sW(wchar_t *buf);
 
     unsigned int mtime_tick();
+    /* 高精度单调时钟，单位纳秒，只用来算时间差 */
+    unsigned long long mtime_ns();
 
 #endif
 
@@ -0,0 +1,670 @@
+﻿
+#include <stdlib.h>
+#include <string.h>
+#include "rset.h"
+
+/* 一个位图块 65536 位 */
+#define RSET_MAP_WORDS      1024
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+
+static inline int rset__ctz64(unsigned long long v)
+{
+    unsigned long i;
+
+    if ((unsigned int)v) {
+        _BitScanForward(&i, (unsigned int)v);
+        return (int)i;
+    }
+    _BitScanForward(&i, (unsigned int)(v >> 32));
+    return (int)i + 32;
+}
+
+static inline int rset__popcount64(unsigned long long v)
+{
+    v = v - ((v >> 1) & 0x5555555555555555ull);
+    v = (v & 0x3333333333333333ull) + ((v >> 2) & 0x3333333333333333ull);
+    v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+
+    return (int)((v * 0x0101010101010101ull) >> 56);
+}
+#else
+#define rset__ctz64(v)          __builtin_ctzll(v)
+#define rset__popcount64(v)     __builtin_popcountll(v)
+#endif
+
+#define rset__map_has(c, low)   (((c)->u.map[(low) >> 6] >> ((low) & 63)) & 1)
+
+static void     rset__chunk_free(struct rset_chunk *c)
+{
+    if (c->type == RSET_BITMAP) {
+        if (c->u.map)   free(c->u.map);
+    }
+    else if (c->u.arr)  free(c->u.arr);
+
+    memset(c, 0, sizeof (c[0]));
+}
+
+/* 第一个 >= low 的元素的下标 */
+static int      rset__arr_lower(struct rset_chunk *c, int low)
+{
+    int l = 0, r = c->num, m;
+
+    while (l < r) {
+        m = (l + r) / 2;
+        if (c->u.arr[m] < low) l = m + 1;
+        else r = m;
+    }
+
+    return l;
+}
+
+static int      rset__chunk_has(struct rset_chunk *c, int low)
+{
+    int i;
+
+    if (c->type == RSET_BITMAP)
+        return (int)rset__map_has(c, low);
+
+    i = rset__arr_lower(c, low);
+    return (i < c->num) && (c->u.arr[i] == low);
+}
+
+static int      rset__arr_reserve(struct rset_chunk *c, int cap)
+{
+    unsigned short *p;
+
+    if (cap <= c->cap)
+        return 0;
+
+    if (cap < c->cap * 2) cap = c->cap * 2;
+    if (cap < 4) cap = 4;
+    if (cap > RSET_ARRAY_MAX) cap = RSET_ARRAY_MAX;
+
+    p = (unsigned short *)realloc(c->u.arr, cap * sizeof (p[0]));
+    if (!p)
+        return -1;
+
+    c->u.arr = p;
+    c->cap = cap;
+
+    return 0;
+}
+
+static int      rset__to_bitmap(struct rset_chunk *c)
+{
+    unsigned long long *map = (unsigned long long *)calloc(RSET_MAP_WORDS, sizeof (map[0]));
+    int i;
+
+    if (!map)
+        return -1;
+
+    for (i = 0; i < c->num; i++)
+        map[c->u.arr[i] >> 6] |= 1ull << (c->u.arr[i] & 63);
+
+    if (c->u.arr) free(c->u.arr);
+    c->u.map = map;
+    c->type = RSET_BITMAP;
+    c->cap = 0;
+
+    return 0;
+}
+
+static int      rset__to_array(struct rset_chunk *c)
+{
+    unsigned short *arr = (unsigned short *)malloc((c->num ? c->num : 1) * sizeof (arr[0]));
+    unsigned long long w;
+    int i, n = 0;
+
+    if (!arr)
+        return -1;
+
+    for (i = 0; i < RSET_MAP_WORDS; i++) {
+        for (w = c->u.map[i]; w; w &= w - 1)
+            arr[n++] = (unsigned short)(i * 64 + rset__ctz64(w));
+    }
+
+    free(c->u.map);
+    c->u.arr = arr;
+    c->type = RSET_ARRAY;
+    c->cap = c->num ? c->num : 1;
+
+    return 0;
+}
+
+static void     rset__map_recount(struct rset_chunk *c)
+{
+    int i, n = 0;
+
+    for (i = 0; i < RSET_MAP_WORDS; i++)
+        n += rset__popcount64(c->u.map[i]);
+
+    c->num = n;
+}
+
+/* 位图改完以后，元素少了换回数组，保证表示只由元素个数决定 */
+static int      rset__map_fix(struct rset_chunk *c)
+{
+    rset__map_recount(c);
+
+    return (c->num <= RSET_ARRAY_MAX) ? rset__to_array(c) : 0;
+}
+
+/* 找key对应的块，找不到时 idx 是插入的位置 */
+static struct rset_chunk*   rset__find(struct rset *s, int key, int *idx)
+{
+    int l = 0, r = s->num, m;
+
+    while (l < r) {
+        m = (l + r) / 2;
+        if (s->chunks[m].key < key) l = m + 1;
+        else r = m;
+    }
+
+    if (idx) *idx = l;
+
+    return ((l < s->num) && (s->chunks[l].key == key)) ? &s->chunks[l] : NULL;
+}
+
+static struct rset_chunk*   rset__insert(struct rset *s, int idx, int key)
+{
+    struct rset_chunk *p;
+    int cap;
+
+    if (s->num == s->cap) {
+        cap = s->cap ? (s->cap * 2) : 4;
+        p = (struct rset_chunk *)realloc(s->chunks, cap * sizeof (p[0]));
+        if (!p)
+            return NULL;
+
+        s->chunks = p;
+        s->cap = cap;
+    }
+
+    memmove(s->chunks + idx + 1, s->chunks + idx, (s->num - idx) * sizeof (s->chunks[0]));
+    s->num++;
+
+    p = &s->chunks[idx];
+    memset(p, 0, sizeof (p[0]));
+    p->key = (unsigned short)key;
+    p->type = RSET_ARRAY;
+
+    return p;
+}
+
+static void     rset__remove(struct rset *s, int idx)
+{
+    rset__chunk_free(&s->chunks[idx]);
+    memmove(s->chunks + idx, s->chunks + idx + 1, (s->num - idx - 1) * sizeof (s->chunks[0]));
+    s->num--;
+}
+
+/* 去掉空块 */
+static void     rset__compact(struct rset *s)
+{
+    int i, n = 0;
+
+    for (i = 0; i < s->num; i++) {
+        if (!s->chunks[i].num) {
+            rset__chunk_free(&s->chunks[i]);
+            continue;
+        }
+        s->chunks[n++] = s->chunks[i];
+    }
+
+    s->num = n;
+}
+
+static int      rset__chunk_clone(struct rset_chunk *dst, struct rset_chunk *src)
+{
+    memset(dst, 0, sizeof (dst[0]));
+    dst->key = src->key;
+    dst->type = src->type;
+    dst->num = src->num;
+
+    if (src->type == RSET_BITMAP) {
+        dst->u.map = (unsigned long long *)malloc(RSET_MAP_WORDS * sizeof (dst->u.map[0]));
+        if (!dst->u.map)
+            return -1;
+        memcpy(dst->u.map, src->u.map, RSET_MAP_WORDS * sizeof (dst->u.map[0]));
+    }
+    else {
+        dst->cap = src->num ? src->num : 1;
+        dst->u.arr = (unsigned short *)malloc(dst->cap * sizeof (dst->u.arr[0]));
+        if (!dst->u.arr)
+            return -1;
+        memcpy(dst->u.arr, src->u.arr, src->num * sizeof (dst->u.arr[0]));
+    }
+
+    return 0;
+}
+
+struct rset*    rset_init(struct rset *s)
+{
+    memset(s, 0, sizeof (s[0]));
+
+    return s;
+}
+
+void            rset_uninit(struct rset *s)
+{
+    rset_clear(s);
+    if (s->chunks) free(s->chunks);
+
+    memset(s, 0, sizeof (s[0]));
+}
+
+void            rset_clear(struct rset *s)
+{
+    int i;
+
+    for (i = 0; i < s->num; i++)
+        rset__chunk_free(&s->chunks[i]);
+
+    s->num = 0;
+}
+
+int             rset_set(struct rset *s, int v, int val)
+{
+    struct rset_chunk *c;
+    unsigned long long bit, *w;
+    int idx, i, low = v & 0xffff;
+
+    if (v < 0)
+        return 0;
+
+    if (!(c = rset__find(s, v >> 16, &idx))) {
+        if (!val)
+            return 0;
+        if (!(c = rset__insert(s, idx, v >> 16)))
+            return -1;
+    }
+
+    if (c->type == RSET_BITMAP) {
+        w = &c->u.map[low >> 6];
+        bit = 1ull << (low & 63);
+        if (val && !(*w & bit)) {
+            *w |= bit;
+            c->num++;
+        }
+        else if (!val && (*w & bit)) {
+            *w &= ~bit;
+            if (--c->num <= RSET_ARRAY_MAX)
+                return rset__to_array(c);
+        }
+
+        return 0;
+    }
+
+    i = rset__arr_lower(c, low);
+    if ((i < c->num) && (c->u.arr[i] == low)) {
+        if (val)
+            return 0;
+
+        memmove(c->u.arr + i, c->u.arr + i + 1, (c->num - i - 1) * sizeof (c->u.arr[0]));
+        if (!--c->num)
+            rset__remove(s, (int)(c - s->chunks));
+
+        return 0;
+    }
+
+    if (!val)
+        return 0;
+
+    if (c->num == RSET_ARRAY_MAX) {
+        if (rset__to_bitmap(c))
+            return -1;
+        c->u.map[low >> 6] |= 1ull << (low & 63);
+        c->num++;
+        return 0;
+    }
+
+    if (rset__arr_reserve(c, c->num + 1)) {
+        if (!c->num)
+            rset__remove(s, (int)(c - s->chunks));
+        return -1;
+    }
+
+    memmove(c->u.arr + i + 1, c->u.arr + i, (c->num - i) * sizeof (c->u.arr[0]));
+    c->u.arr[i] = (unsigned short)low;
+    c->num++;
+
+    return 0;
+}
+
+int             rset_get(struct rset *s, int v)
+{
+    struct rset_chunk *c;
+
+    if ((v < 0) || !(c = rset__find(s, v >> 16, NULL)))
+        return 0;
+
+    return rset__chunk_has(c, v & 0xffff);
+}
+
+int             rset_count(struct rset *s)
+{
+    int i, n = 0;
+
+    for (i = 0; i < s->num; i++)
+        n += s->chunks[i].num;
+
+    return n;
+}
+
+int             rset_is_empty(struct rset *s)
+{
+    return !s->num;
+}
+
+int             rset_is_equal(struct rset *a, struct rset *b)
+{
+    struct rset_chunk *x, *y;
+    int i;
+
+    if (a->num != b->num)
+        return 0;
+
+    for (i = 0; i < a->num; i++) {
+        x = &a->chunks[i];
+        y = &b->chunks[i];
+        if ((x->key != y->key) || (x->num != y->num))
+            return 0;
+
+        if (x->type == RSET_BITMAP) {
+            if (memcmp(x->u.map, y->u.map, RSET_MAP_WORDS * sizeof (x->u.map[0])))
+                return 0;
+        }
+        else if (memcmp(x->u.arr, y->u.arr, x->num * sizeof (x->u.arr[0])))
+            return 0;
+    }
+
+    return 1;
+}
+
+int             rset_next_bit_pos(struct rset *s, int pos)
+{
+    struct rset_chunk *c;
+    unsigned long long w;
+    int idx, low, i;
+
+    if (pos < 0)
+        return -1;
+
+    rset__find(s, pos >> 16, &idx);
+    for (; idx < s->num; idx++) {
+        c = &s->chunks[idx];
+        low = (c->key == (pos >> 16)) ? (pos & 0xffff) : 0;
+
+        if (c->type == RSET_ARRAY) {
+            if ((i = rset__arr_lower(c, low)) < c->num)
+                return (c->key << 16) | c->u.arr[i];
+            continue;
+        }
+
+        i = low >> 6;
+        w = c->u.map[i] & (~0ull << (low & 63));
+        while (!w && (++i < RSET_MAP_WORDS))
+            w = c->u.map[i];
+        if (w)
+            return (c->key << 16) | (i * 64 + rset__ctz64(w));
+    }
+
+    return -1;
+}
+
+struct rset*    rset_clone(struct rset *dst, struct rset *src)
+{
+    int i;
+
+    if (dst == src)
+        return dst;
+
+    rset_clear(dst);
+    for (i = 0; i < src->num; i++) {
+        if (!rset__insert(dst, dst->num, src->chunks[i].key)
+            || rset__chunk_clone(&dst->chunks[dst->num - 1], &src->chunks[i])) {
+            rset__compact(dst);
+            return NULL;
+        }
+    }
+
+    return dst;
+}
+
+/* 两个有序数组求并，结果超过 RSET_ARRAY_MAX 个时换成位图 */
+static int      rset__chunk_or(struct rset_chunk *d, struct rset_chunk *s)
+{
+    unsigned short *arr;
+    int i, j, n;
+
+    if ((d->type == RSET_ARRAY) && (s->type == RSET_ARRAY) && (d->num + s->num <= RSET_ARRAY_MAX)) {
+        arr = (unsigned short *)malloc((d->num + s->num) * sizeof (arr[0]));
+        if (!arr)
+            return -1;
+
+        for (i = j = n = 0; (i < d->num) || (j < s->num); ) {
+            if ((j == s->num) || ((i < d->num) && (d->u.arr[i] < s->u.arr[j])))
+                arr[n++] = d->u.arr[i++];
+            else if ((i == d->num) || (s->u.arr[j] < d->u.arr[i]))
+                arr[n++] = s->u.arr[j++];
+            else {
+                arr[n++] = d->u.arr[i++];
+                j++;
+            }
+        }
+
+        free(d->u.arr);
+        d->u.arr = arr;
+        d->cap = d->num + s->num;
+        d->num = n;
+        return 0;
+    }
+
+    if ((d->type == RSET_ARRAY) && rset__to_bitmap(d))
+        return -1;
+
+    if (s->type == RSET_BITMAP) {
+        for (i = 0; i < RSET_MAP_WORDS; i++)
+            d->u.map[i] |= s->u.map[i];
+    }
+    else {
+        for (i = 0; i < s->num; i++)
+            d->u.map[s->u.arr[i] >> 6] |= 1ull << (s->u.arr[i] & 63);
+    }
+
+    return rset__map_fix(d);
+}
+
+struct rset*    rset_or(struct rset *dst, struct rset *src)
+{
+    struct rset_chunk *c;
+    int i, idx;
+
+    if (dst == src)
+        return dst;
+
+    for (i = 0; i < src->num; i++) {
+        if ((c = rset__find(dst, src->chunks[i].key, &idx))) {
+            if (rset__chunk_or(c, &src->chunks[i]))
+                return NULL;
+            continue;
+        }
+
+        if (!(c = rset__insert(dst, idx, src->chunks[i].key)) || rset__chunk_clone(c, &src->chunks[i])) {
+            rset__compact(dst);
+            return NULL;
+        }
+    }
+
+    return dst;
+}
+
+/* 数组按另一块过滤，keep 为1留下在s里的，为0留下不在s里的 */
+static void     rset__arr_filter(struct rset_chunk *d, struct rset_chunk *s, int keep)
+{
+    int i, n = 0;
+
+    for (i = 0; i < d->num; i++) {
+        if (rset__chunk_has(s, d->u.arr[i]) == keep)
+            d->u.arr[n++] = d->u.arr[i];
+    }
+
+    d->num = n;
+}
+
+static int      rset__chunk_and(struct rset_chunk *d, struct rset_chunk *s)
+{
+    unsigned short *arr;
+    int i, n = 0;
+
+    if (d->type == RSET_ARRAY) {
+        rset__arr_filter(d, s, 1);
+        return 0;
+    }
+
+    if (s->type == RSET_BITMAP) {
+        for (i = 0; i < RSET_MAP_WORDS; i++)
+            d->u.map[i] &= s->u.map[i];
+        return rset__map_fix(d);
+    }
+
+    /* 位图 & 数组，结果一定不超过数组的大小 */
+    arr = (unsigned short *)malloc((s->num ? s->num : 1) * sizeof (arr[0]));
+    if (!arr)
+        return -1;
+
+    for (i = 0; i < s->num; i++) {
+        if (rset__map_has(d, s->u.arr[i]))
+            arr[n++] = s->u.arr[i];
+    }
+
+    free(d->u.map);
+    d->u.arr = arr;
+    d->type = RSET_ARRAY;
+    d->cap = s->num ? s->num : 1;
+    d->num = n;
+
+    return 0;
+}
+
+struct rset*    rset_and(struct rset *dst, struct rset *src)
+{
+    struct rset_chunk *c, *sc;
+    int i, ret = 0;
+
+    if (dst == src)
+        return dst;
+
+    for (i = 0; i < dst->num; i++) {
+        c = &dst->chunks[i];
+        if (!(sc = rset__find(src, c->key, NULL)))
+            c->num = 0;
+        else if (rset__chunk_and(c, sc))
+            ret = -1;
+    }
+
+    rset__compact(dst);
+
+    return ret ? NULL : dst;
+}
+
+static int      rset__chunk_sub(struct rset_chunk *d, struct rset_chunk *s)
+{
+    int i;
+
+    if (d->type == RSET_ARRAY) {
+        rset__arr_filter(d, s, 0);
+        return 0;
+    }
+
+    if (s->type == RSET_BITMAP) {
+        for (i = 0; i < RSET_MAP_WORDS; i++)
+            d->u.map[i] &= ~s->u.map[i];
+    }
+    else {
+        for (i = 0; i < s->num; i++)
+            d->u.map[s->u.arr[i] >> 6] &= ~(1ull << (s->u.arr[i] & 63));
+    }
+
+    return rset__map_fix(d);
+}
+
+struct rset*    rset_sub(struct rset *dst, struct rset *src)
+{
+    struct rset_chunk *c, *sc;
+    int i, ret = 0;
+
+    if (dst == src) {
+        rset_clear(dst);
+        return dst;
+    }
+
+    for (i = 0; i < dst->num; i++) {
+        c = &dst->chunks[i];
+        if ((sc = rset__find(src, c->key, NULL)) && rset__chunk_sub(c, sc))
+            ret = -1;
+    }
+
+    rset__compact(dst);
+
+    return ret ? NULL : dst;
+}
+
+struct rset*    rset_from_words(struct rset *dst, const unsigned int *words, int n)
+{
+    struct rset_chunk *c;
+    unsigned int w;
+    int base, i, j, cnt, key;
+
+    rset_clear(dst);
+
+    /* 每块 65536 位，是 2048 个int */
+    for (base = 0, key = 0; base < n; base += 2048, key++) {
+        for (i = base, cnt = 0; (i < n) && (i < base + 2048); i++) {
+            if (words[i])
+                cnt += rset__popcount64(words[i]);
+        }
+        if (!cnt) continue;
+
+        if (!(c = rset__insert(dst, dst->num, key)))
+            return NULL;
+
+        if (cnt > RSET_ARRAY_MAX) {
+            if (rset__to_bitmap(c))
+                return NULL;
+            for (i = base, j = 0; (i < n) && (i < base + 2048); i++, j++)
+                c->u.map[j / 2] |= (unsigned long long)words[i] << ((j & 1) * 32);
+        }
+        else {
+            c->u.arr = (unsigned short *)malloc(cnt * sizeof (c->u.arr[0]));
+            if (!c->u.arr) {
+                rset__remove(dst, dst->num - 1);
+                return NULL;
+            }
+            c->cap = cnt;
+            for (i = base, j = 0; (i < n) && (i < base + 2048); i++) {
+                for (w = words[i]; w; w &= w - 1)
+                    c->u.arr[j++] = (unsigned short)((i - base) * 32 + rset__ctz64(w));
+            }
+        }
+        c->num = cnt;
+    }
+
+    return dst;
+}
+
+int             rset_bytes(struct rset *s)
+{
+    int i, n = s->cap * (int)sizeof (s->chunks[0]);
+
+    for (i = 0; i < s->num; i++) {
+        if (s->chunks[i].type == RSET_BITMAP)
+            n += RSET_MAP_WORDS * sizeof (s->chunks[i].u.map[0]);
+        else
+            n += s->chunks[i].cap * sizeof (s->chunks[i].u.arr[0]);
+    }
+
+    return n;
+}
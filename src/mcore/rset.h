@@ -0,0 +1,71 @@
+﻿#ifndef __rset_h__
+#define __rset_h__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /* 稀疏/稠密混合的非负整数集合(roaring)。按高16位分块，块内元素不超过 RSET_ARRAY_MAX
+    个时用有序的 unsigned short 数组存，超过了换成 65536 位的位图，空块直接删掉。
+    元素很稀疏、但是编号很大的集合(比如指令id)比 bitset 省很多内存 */
+#define RSET_ARRAY_MAX      4096
+#define RSET_ARRAY          0
+#define RSET_BITMAP         1
+
+    struct rset_chunk
+    {
+        /* 元素的高16位 */
+        unsigned short  key;
+        /* RSET_ARRAY / RSET_BITMAP，由 num 决定，所以相同的集合表示也相同 */
+        unsigned short  type;
+        int             num;
+        /* 数组的容量，位图不用 */
+        int             cap;
+        union {
+            unsigned short      *arr;
+            unsigned long long  *map;
+        } u;
+    };
+
+    struct rset
+    {
+        /* 按 key 升序排好的块 */
+        struct rset_chunk   *chunks;
+        int                 num;
+        int                 cap;
+    };
+
+#define RSET_INIT(a)        struct rset a = {0}
+
+    struct rset*    rset_init(struct rset *s);
+    void            rset_uninit(struct rset *s);
+    /* 清空元素，块数组的内存留着复用 */
+    void            rset_clear(struct rset *s);
+
+    /* 和 bitset_set 一样，val 是 0/1，失败返回 -1 */
+    int             rset_set(struct rset *s, int v, int val);
+    int             rset_get(struct rset *s, int v);
+    int             rset_count(struct rset *s);
+    int             rset_is_empty(struct rset *s);
+    int             rset_is_equal(struct rset *a, struct rset *b);
+    int             rset_next_bit_pos(struct rset *s, int pos);
+
+    struct rset*    rset_clone(struct rset *dst, struct rset *src);
+    struct rset*    rset_or(struct rset *dst, struct rset *src);
+    struct rset*    rset_and(struct rset *dst, struct rset *src);
+    /* dst = dst - src */
+    struct rset*    rset_sub(struct rset *dst, struct rset *src);
+
+    /* 从 bitset 的int数组生成，n 是int数 */
+    struct rset*    rset_from_words(struct rset *dst, const unsigned int *words, int n);
+    /* 占用的堆内存，字节 */
+    int             rset_bytes(struct rset *s);
+
+#define rset_foreach(s, _i) \
+    for (_i = rset_next_bit_pos(s, 0); _i >= 0; _i = rset_next_bit_pos(s, _i + 1))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif